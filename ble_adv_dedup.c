@@ -0,0 +1,79 @@
+#include <string.h>
+#include "ble_adv_dedup.h"
+
+#define DEDUP_MASK            (BEACON_DEDUP_SIZE - 1u)
+#define FNV_OFFSET            (0x811C9DC5u)
+#define FNV_PRIME             (0x01000193u)
+
+#define DEDUP_LOAD_RELAXED(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define DEDUP_STORE_RELAXED(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+
+typedef struct
+{
+    uint8_t addr[BEACON_ADDR_LEN];
+    uint8_t used;
+    uint32_t payload_hash;
+    uint32_t first_seen_ms;
+} DEDUP_ENTRY_T;
+
+static DEDUP_ENTRY_T dedup_tbl[BEACON_DEDUP_SIZE];
+static uint32_t dedup_window_ms;
+
+// written by the BLE event context only, read by the publisher
+static uint32_t dedup_hits;
+static uint32_t dedup_misses;
+
+
+static uint32_t fnv1a(uint32_t h, const uint8_t *data, uint32_t len)
+{
+    uint32_t i;
+
+    for(i = 0; i < len; i++)
+    {
+        h = (h ^ data[i]) * FNV_PRIME;
+    }
+    return h;
+}
+
+void init_adv_dedup(uint32_t window_ms)
+{
+    memset(dedup_tbl, 0, sizeof(dedup_tbl));
+    dedup_window_ms = window_ms;
+    dedup_hits      = 0;
+    dedup_misses    = 0;
+}
+
+// return 1 if the same advertiser sent the same payload within the window,
+// else record the report and return 0
+uint8_t adv_is_duplicate(const uint8_t addr[BEACON_ADDR_LEN], const uint8_t *data, uint32_t data_len, uint32_t now_ms)
+{
+    uint32_t payload_hash = fnv1a(FNV_OFFSET, data, data_len);
+    DEDUP_ENTRY_T *e = &dedup_tbl[fnv1a(FNV_OFFSET, addr, BEACON_ADDR_LEN) & DEDUP_MASK];
+
+    if(e->used && e->payload_hash == payload_hash &&
+       (uint32_t)(now_ms - e->first_seen_ms) < dedup_window_ms &&
+       memcmp(e->addr, addr, BEACON_ADDR_LEN) == 0)
+    {
+        DEDUP_STORE_RELAXED(&dedup_hits, dedup_hits + 1u);
+        return 1;
+    }
+
+    memcpy(e->addr, addr, BEACON_ADDR_LEN);
+    e->used          = 1;
+    e->payload_hash  = payload_hash;
+    e->first_seen_ms = now_ms;
+    DEDUP_STORE_RELAXED(&dedup_misses, dedup_misses + 1u);
+    return 0;
+}
+
+// advertisements dropped as duplicates since init
+uint32_t get_adv_dedup_hits()
+{
+    return DEDUP_LOAD_RELAXED(&dedup_hits);
+}
+
+// advertisements let through since init
+uint32_t get_adv_dedup_misses()
+{
+    return DEDUP_LOAD_RELAXED(&dedup_misses);
+}
@@ -0,0 +1,36 @@
+#ifndef BLE_ADV_DEDUP_H
+#define BLE_ADV_DEDUP_H
+
+#include <inttypes.h>
+#include "ble_beacon.h"
+
+// advertisers tracked by the duplicate filter, power of two,
+// override with "beacon-dedup-size" in mbed_app.json
+#ifndef BEACON_DEDUP_SIZE
+#define BEACON_DEDUP_SIZE     (256)
+#endif
+
+#if (BEACON_DEDUP_SIZE & (BEACON_DEDUP_SIZE - 1)) != 0
+#error "BEACON_DEDUP_SIZE must be a power of two"
+#endif
+
+// milliseconds an identical advertisement is suppressed for,
+// override with "beacon-dedup-window-ms" in mbed_app.json
+#ifndef BEACON_DEDUP_WINDOW_MS
+#define BEACON_DEDUP_WINDOW_MS (1000)
+#endif
+
+// Direct-mapped filter, one entry per advertiser address: the entry holds the
+// address, a hash of the last payload and when that payload was first let
+// through. A report is a duplicate if address and payload hash match and the
+// entry is younger than the window. The timestamp is not refreshed on a hit,
+// so a beacon repeating the same payload still passes once per window and
+// does not look silent to the eviction timer. Colliding addresses simply
+// replace each other, which only costs a missed duplicate.
+// Called from the BLE event context only.
+void init_adv_dedup(uint32_t window_ms);
+uint8_t adv_is_duplicate(const uint8_t addr[BEACON_ADDR_LEN], const uint8_t *data, uint32_t data_len, uint32_t now_ms);
+uint32_t get_adv_dedup_hits();
+uint32_t get_adv_dedup_misses();
+
+#endif // BLE_ADV_DEDUP_H
@@ -0,0 +1,73 @@
+#include <stddef.h>
+#include "ble_adv_parser.h"
+
+// bit set in ble_adv_find_payload() result for each field found
+#define ADV_FOUND_MANUFACTURER (0x01u)
+#define ADV_FOUND_SERVICE_DATA (0x02u)
+#define ADV_FOUND_ALL          (ADV_FOUND_MANUFACTURER | ADV_FOUND_SERVICE_DATA)
+
+
+void ble_ad_iter_init(BLE_AD_ITER_T *it, const uint8_t *data, uint32_t data_len)
+{
+    it->pos = data;
+    it->end = data + data_len;
+}
+
+// get next AD structure, return 1 if field is set, 0 at end of data
+uint8_t ble_ad_iter_next(BLE_AD_ITER_T *it, BLE_AD_FIELD_T *field)
+{
+    uint32_t remaining = (uint32_t)(it->end - it->pos);
+    uint8_t ad_len;
+
+    if(remaining < 2)
+    {
+        it->pos = it->end;
+        return 0;
+    }
+
+    // length covers the type byte and the value
+    ad_len = it->pos[0];
+    if(ad_len == 0 || ad_len > remaining - 1)
+    {
+        it->pos = it->end;
+        return 0;
+    }
+
+    field->type  = it->pos[1];
+    field->len   = (uint8_t)(ad_len - 1);
+    field->value = it->pos + 2;
+    it->pos += 1u + ad_len;
+    return 1;
+}
+
+// find manufacturer specific and service data in one pass, first occurrence of each,
+// return 1 if at least one of them is present
+uint8_t ble_adv_find_payload(const uint8_t *data, uint32_t data_len, BLE_ADV_PAYLOAD_T *payload)
+{
+    BLE_AD_ITER_T it;
+    BLE_AD_FIELD_T field;
+    uint8_t found = 0;
+
+    payload->manufacturer.type  = BLE_AD_TYPE_MANUFACTURER_DATA;
+    payload->manufacturer.len   = 0;
+    payload->manufacturer.value = NULL;
+    payload->service_data.type  = BLE_AD_TYPE_SERVICE_DATA_16;
+    payload->service_data.len   = 0;
+    payload->service_data.value = NULL;
+
+    ble_ad_iter_init(&it, data, data_len);
+    while(found != ADV_FOUND_ALL && ble_ad_iter_next(&it, &field))
+    {
+        if(field.type == BLE_AD_TYPE_MANUFACTURER_DATA && !(found & ADV_FOUND_MANUFACTURER))
+        {
+            payload->manufacturer = field;
+            found |= ADV_FOUND_MANUFACTURER;
+        }
+        else if(field.type == BLE_AD_TYPE_SERVICE_DATA_16 && !(found & ADV_FOUND_SERVICE_DATA))
+        {
+            payload->service_data = field;
+            found |= ADV_FOUND_SERVICE_DATA;
+        }
+    }
+    return found ? 1 : 0;
+}
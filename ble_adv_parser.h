@@ -0,0 +1,42 @@
+#ifndef BLE_ADV_PARSER_H
+#define BLE_ADV_PARSER_H
+
+#include <inttypes.h>
+
+// AD types used by the beacon schemas (Bluetooth Assigned Numbers)
+#define BLE_AD_TYPE_FLAGS             (0x01u)
+#define BLE_AD_TYPE_COMPLETE_NAME     (0x09u)
+#define BLE_AD_TYPE_SERVICE_DATA_16   (0x16u)
+#define BLE_AD_TYPE_MANUFACTURER_DATA (0xFFu)
+
+// one AD structure, value points into the advertising data it was parsed from
+typedef struct
+{
+    uint8_t type;
+    uint8_t len;          // value length, excluding the type byte
+    const uint8_t *value;
+} BLE_AD_FIELD_T;
+
+// iterator over the length/type/value structures of one advertising payload
+typedef struct
+{
+    const uint8_t *pos;
+    const uint8_t *end;
+} BLE_AD_ITER_T;
+
+// views of the payload fields the beacon schemas look at, len 0 if absent
+typedef struct
+{
+    BLE_AD_FIELD_T manufacturer;
+    BLE_AD_FIELD_T service_data;
+} BLE_ADV_PAYLOAD_T;
+
+// The iterator never copies or allocates, fields stay valid as long as the
+// advertising data buffer does. Iteration stops at the end of the data, at a
+// zero length byte (start of padding) and at a structure that would run past
+// the end of the data.
+void ble_ad_iter_init(BLE_AD_ITER_T *it, const uint8_t *data, uint32_t data_len);
+uint8_t ble_ad_iter_next(BLE_AD_ITER_T *it, BLE_AD_FIELD_T *field);
+uint8_t ble_adv_find_payload(const uint8_t *data, uint32_t data_len, BLE_ADV_PAYLOAD_T *payload);
+
+#endif // BLE_ADV_PARSER_H
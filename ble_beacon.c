@@ -1,98 +1,792 @@
-
 #include <stdio.h>
 #include <string.h>
 #include "ble_beacon.h"
 
+#define BEACON_HASH_MASK  (BEACON_HASH_SIZE - 1u)
+#define BEACON_SLOT_NONE  (0xFFFFu)
+#define BEACON_WHEEL_MASK (BEACON_WHEEL_SIZE - 1u)
+
+#define BEACON_IMAGE_MAGIC   (0x4E434542u) // "BECN"
+#define BEACON_IMAGE_VERSION (4u)
+
+#if MAX_CONNECTED_BEACONS + BEACON_WHEEL_SIZE > 0xFFFF
+#error "MAX_CONNECTED_BEACONS + BEACON_WHEEL_SIZE must fit in a 16-bit node index"
+#endif
+
+#define SEQ_LOAD_RELAXED(p)      __atomic_load_n((p), __ATOMIC_RELAXED)
+#define SEQ_LOAD_ACQUIRE(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define SEQ_STORE_RELAXED(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define SEQ_STORE_RELEASE(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+static BEACON_TBL_T beacon_tbl;
+
+// open addressing index (linear probing): key hash -> tbl index
+static uint16_t beacon_hash[BEACON_HASH_SIZE];
+
+// history rings of all slots, slot i owns BEACON_HISTORY_SIZE samples starting at i * BEACON_HISTORY_SIZE
+static BEACON_HISTORY_REC_T history_slab[MAX_CONNECTED_BEACONS * BEACON_HISTORY_SIZE];
+
+// stack of unused slots in beacon_tbl
+static uint16_t free_slots[MAX_CONNECTED_BEACONS];
+static uint32_t free_count;
+
+// bumped on every change of the set of tracked advertisers
+static uint32_t membership_gen;
+
+// slots whose data changed since the publisher last took them, bit i <-> beacon_tbl[i]
+static uint32_t beacon_dirty[BEACON_BMP_WORDS];
+
+// slots in use, bit i <-> beacon_tbl[i], published as the validity bitmap
+static uint32_t beacon_valid[BEACON_BMP_WORDS];
+
+// Hashed timer wheel for eviction, bucket (t % BEACON_WHEEL_SIZE) holds slots
+// whose deadline fell on second t when they were last scheduled. Updates do not
+// touch the wheel; a slot found alive when its bucket fires is rescheduled.
+// Nodes 0..MAX_CONNECTED_BEACONS-1 are slots, the rest are the bucket list heads.
+#define WHEEL_HEAD(b)     (MAX_CONNECTED_BEACONS + (b))
+static uint16_t wheel_next[MAX_CONNECTED_BEACONS + BEACON_WHEEL_SIZE];
+static uint16_t wheel_prev[MAX_CONNECTED_BEACONS + BEACON_WHEEL_SIZE];
+static time_t wheel_time;
+
+#if BEACON_COMPACT_RECORDS
+// absolute time of relative timestamp 0, stored 0 means "before time_base"
+static time_t time_base;
+#endif
+
+// registry image header, followed by beacon_tbl and history_slab as stored in memory
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t compact;      // BEACON_COMPACT_RECORDS of the writer
+    uint32_t capacity;     // MAX_CONNECTED_BEACONS of the writer
+    uint32_t history_size; // BEACON_HISTORY_SIZE of the writer
+    uint32_t tbl_bytes;
+    uint32_t slab_bytes;
+    uint32_t checksum;     // FNV-1a over table and history
+    uint32_t reserved;
+    int64_t time_base;
+} BEACON_IMAGE_HDR_T;
+
+// running counter used to generate unique addresses for dummy beacons
+static uint32_t dummy_addr_counter;
+
+
+// 48-bit address and payload ID packed into one 56-bit key
+static uint64_t beacon_key(const uint8_t addr[BEACON_ADDR_LEN], uint8_t id)
+{
+    uint64_t key = 0;
+    uint32_t i;
+
+    for(i = 0; i < BEACON_ADDR_LEN; i++)
+    {
+        key = (key << 8) | addr[i];
+    }
+
+    return (key << 8) | id;
+}
+
+static uint32_t beacon_hash_pos(uint64_t key)
+{
+    // Fibonacci hashing, high bits folded down so the mask sees all of them
+    uint64_t h = key * 0x9E3779B97F4A7C15ull;
+
+    return (uint32_t)(h ^ (h >> 32)) & BEACON_HASH_MASK;
+}
+
+static void mark_dirty(uint32_t slot)
+{
+    beacon_dirty[slot >> 5] |= (0x1u << (slot & 31u));
+}
+
+// Seqlock writer side. The table has a single writer, readers on other threads
+// use read_beacon_snapshot() and retry if they overlap a write.
+static void slot_write_begin(uint32_t slot)
+{
+    SEQ_STORE_RELAXED(&beacon_tbl.seq[slot], beacon_tbl.seq[slot] + 1u);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void slot_write_end(uint32_t slot)
+{
+    SEQ_STORE_RELEASE(&beacon_tbl.seq[slot], beacon_tbl.seq[slot] + 1u);
+}
+
+// append sample to slot's history ring, oldest sample is overwritten when full,
+// must be called between slot_write_begin() and slot_write_end()
+static void history_append(uint32_t slot, beacon_time_t timestamp, beacon_temp_t value)
+{
+    BEACON_HISTORY_REC_T *ring = &history_slab[slot * BEACON_HISTORY_SIZE];
+    uint32_t head = beacon_tbl.hist_head[slot];
+
+    ring[head].timestamp = timestamp;
+    ring[head].value     = value;
+
+    beacon_tbl.hist_head[slot] = (uint16_t)((head + 1u < BEACON_HISTORY_SIZE) ? (head + 1u) : 0u);
+    if(beacon_tbl.hist_count[slot] < BEACON_HISTORY_SIZE)
+    {
+        beacon_tbl.hist_count[slot]++;
+    }
+}
 
-static BEACON_DATA_T beacon_tbl[MAX_CONNECTED_BEACONS];
+static void wheel_insert(uint32_t slot, time_t deadline)
+{
+    uint32_t head = WHEEL_HEAD((uint32_t)deadline & BEACON_WHEEL_MASK);
 
+    wheel_next[slot] = wheel_next[head];
+    wheel_prev[slot] = (uint16_t)head;
+    wheel_prev[wheel_next[head]] = (uint16_t)slot;
+    wheel_next[head] = (uint16_t)slot;
+}
+
+static void wheel_remove(uint32_t slot)
+{
+    wheel_next[wheel_prev[slot]] = wheel_next[slot];
+    wheel_prev[wheel_next[slot]] = wheel_prev[slot];
+}
+
+static uint64_t slot_key(uint32_t slot)
+{
+    return beacon_key(beacon_tbl.info[slot].addr, beacon_tbl.info[slot].id);
+}
+
+// return hash index holding key, or the empty index where it would be inserted
+static uint32_t beacon_hash_probe(uint64_t key)
+{
+    uint32_t pos = beacon_hash_pos(key);
+
+    while(beacon_hash[pos] != BEACON_SLOT_NONE && slot_key(beacon_hash[pos]) != key)
+    {
+        pos = (pos + 1u) & BEACON_HASH_MASK;
+    }
+
+    return pos;
+}
 
 void init_beacon_tbl()
 {
-    memset(beacon_tbl, 0, sizeof(beacon_tbl));
+    uint32_t i;
+
+    memset(&beacon_tbl, 0, sizeof(beacon_tbl));
+    memset(history_slab, 0, sizeof(history_slab));
+    memset(beacon_hash, 0xFF, sizeof(beacon_hash));
+    memset(beacon_dirty, 0, sizeof(beacon_dirty));
+    memset(beacon_valid, 0, sizeof(beacon_valid));
+    for(i = 0; i < BEACON_WHEEL_SIZE; i++)
+    {
+        wheel_next[WHEEL_HEAD(i)] = (uint16_t)WHEEL_HEAD(i);
+        wheel_prev[WHEEL_HEAD(i)] = (uint16_t)WHEEL_HEAD(i);
+    }
+    wheel_time = 0;
+
+    // lowest slots are handed out first
+    for(i = 0; i < MAX_CONNECTED_BEACONS; i++)
+    {
+        free_slots[i] = (uint16_t)(MAX_CONNECTED_BEACONS - 1 - i);
+    }
+    free_count = MAX_CONNECTED_BEACONS;
+    membership_gen++;
+    dummy_addr_counter = 0;
+#if BEACON_COMPACT_RECORDS
+    time_base = 0;
+#endif
 }
 
 // add dummy beacon device to table, return tbl index if ok, else INVALID_U32
 uint32_t add_dummy_beacon( /* TODO: parameters needed when actual beacon connected */ )
 {
+    uint8_t addr[BEACON_ADDR_LEN] = { 0xD0, 0x00, 0x00, 0x00, 0x00, 0x00 };
     uint32_t i;
 
-    for(i = 0; i < MAX_CONNECTED_BEACONS; i++)
+    // dummy devices get a locally administered address from a running counter
+    addr[2] = (uint8_t)(dummy_addr_counter >> 24);
+    addr[3] = (uint8_t)(dummy_addr_counter >> 16);
+    addr[4] = (uint8_t)(dummy_addr_counter >> 8);
+    addr[5] = (uint8_t)(dummy_addr_counter);
+
+    i = add_beacon(addr, 0);
+
+    if(i == INVALID_U32)
     {
-        if(beacon_tbl[i].element_used == 0)
-            break;
+        return INVALID_U32;
     }
+    dummy_addr_counter++;
+
+    // TODO: real data
+    slot_write_begin(i);
+    beacon_tbl.temp[i] = BEACON_TEMP_FROM_C(23.0);
+    slot_write_end(i);
 
-    if(i == MAX_CONNECTED_BEACONS)
+    return i;
+}
+
+// add beacon device to table, return tbl index if ok (or if already added), else INVALID_U32
+uint32_t add_beacon(const uint8_t addr[BEACON_ADDR_LEN], uint8_t id)
+{
+    uint64_t key = beacon_key(addr, id);
+    uint32_t pos = beacon_hash_probe(key);
+    time_t now = time(NULL);
+    beacon_time_t stamp;
+    uint32_t i;
+
+    /* Check if beacon is already added */
+    if(beacon_hash[pos] != BEACON_SLOT_NONE)
+    {
+        return beacon_hash[pos];
+    }
+    if(free_count == 0)
     {
         printf("Beacon device adding failed: maximum number of devices already connected\n");
         return INVALID_U32;
     }
 
-    beacon_tbl[i].element_used = 1u;
-    beacon_tbl[i].updated      = 1u;
+    i = free_slots[--free_count];
+    beacon_hash[pos] = (uint16_t)i;
+    stamp = beacon_time_encode(now);
+
+    slot_write_begin(i);
+    beacon_tbl.info[i].element_used = 1u;
+    beacon_tbl.info[i].id           = id;
+    beacon_tbl.info[i].format       = 0;
+    beacon_tbl.info[i].addr_type    = 0;
+    memcpy(beacon_tbl.info[i].addr, addr, BEACON_ADDR_LEN);
+    mark_dirty(i);
+    beacon_valid[i >> 5] |= (0x1u << (i & 31u));
 
     // TODO: real data
-    beacon_tbl[i].rstp      = INVALID_U32;
-    beacon_tbl[i].lat       = 65.0593177; // uni oulu
-    beacon_tbl[i].lon       = 25.4662935;
-    beacon_tbl[i].temp      = 23.0;
+    beacon_tbl.info[i].rstp = BEACON_RSTP_INVALID;
+    beacon_tbl.info[i].lat  = BEACON_COORD_FROM_DEG(65.0593177); // uni oulu
+    beacon_tbl.info[i].lon  = BEACON_COORD_FROM_DEG(25.4662935);
+    beacon_tbl.temp[i]      = BEACON_TEMP_FROM_C(.0);
+    beacon_tbl.update_time[i] = stamp;
+    beacon_tbl.hist_head[i]   = 0;
+    beacon_tbl.hist_count[i]  = 0;
+    beacon_tbl.rssi_avg[i]    = BEACON_RSSI_NONE;
+    memset(&beacon_tbl.link[i], 0, sizeof(BEACON_LINK_T));
+    slot_write_end(i);
+
+    wheel_insert(i, now + BEACON_SILENCE_TIMEOUT);
+    membership_gen++;
 
     return i;
 }
 
-// add beacon device to table, return tbl index if ok, else INVALID_U32
-uint32_t add_beacon(uint8_t i)
+// return tbl index of the beacon, INVALID_U32 if not in table
+uint32_t find_beacon(const uint8_t addr[BEACON_ADDR_LEN], uint8_t id)
 {
-    //uint32_t i;
-    /*
-    for(i = 0; i < MAX_CONNECTED_BEACONS; i++)
+    uint32_t pos = beacon_hash_probe(beacon_key(addr, id));
+
+    return (beacon_hash[pos] == BEACON_SLOT_NONE) ? INVALID_U32 : beacon_hash[pos];
+}
+
+void delete_beacon(uint32_t tbl_idx)
+{
+    uint32_t hole;
+    uint32_t pos;
+    uint32_t home;
+
+    if(tbl_idx >= MAX_CONNECTED_BEACONS || !beacon_tbl.info[tbl_idx].element_used)
     {
-        if(beacon_tbl[i].element_used == 0)
-            break;
+        printf("delete_beacon: Invalid device index %lu!\n", (unsigned long)tbl_idx);
+        return;
     }
-    */
-    /* Check if beacon is already added */
-    if(beacon_tbl[i].element_used)
+    printf("Deleting beacon %lu\n", (unsigned long)tbl_idx);
+
+    wheel_remove(tbl_idx);
+
+    hole = beacon_hash_probe(slot_key(tbl_idx));
+    beacon_hash[hole] = BEACON_SLOT_NONE;
+
+    // backward shift deletion: pull later chain members into the hole so
+    // lookups never need tombstones
+    pos = (hole + 1u) & BEACON_HASH_MASK;
+    while(beacon_hash[pos] != BEACON_SLOT_NONE)
+    {
+        home = beacon_hash_pos(slot_key(beacon_hash[pos]));
+
+        // move entry unless its home lies cyclically in (hole, pos]
+        if(((pos - home) & BEACON_HASH_MASK) >= ((pos - hole) & BEACON_HASH_MASK))
+        {
+            beacon_hash[hole] = beacon_hash[pos];
+            beacon_hash[pos]  = BEACON_SLOT_NONE;
+            hole = pos;
+        }
+        pos = (pos + 1u) & BEACON_HASH_MASK;
+    }
+
+    slot_write_begin(tbl_idx);
+    memset(&(beacon_tbl.info[tbl_idx]), 0, sizeof(BEACON_INFO_T));
+    beacon_tbl.temp[tbl_idx]        = 0;
+    beacon_tbl.update_time[tbl_idx] = 0;
+    beacon_tbl.hist_head[tbl_idx]   = 0;
+    beacon_tbl.hist_count[tbl_idx]  = 0;
+    beacon_tbl.rssi_avg[tbl_idx]    = BEACON_RSSI_NONE;
+    memset(&beacon_tbl.link[tbl_idx], 0, sizeof(BEACON_LINK_T));
+    slot_write_end(tbl_idx);
+    beacon_dirty[tbl_idx >> 5] &= ~(0x1u << (tbl_idx & 31u));
+    beacon_valid[tbl_idx >> 5] &= ~(0x1u << (tbl_idx & 31u));
+    free_slots[free_count++] = (uint16_t)tbl_idx;
+    membership_gen++;
+}
+
+// count beacons updated within the last deadline seconds, *known is set to
+// the number of beacons in the table
+uint32_t count_fresh_beacons(time_t now, uint32_t deadline, uint32_t *known)
+{
+    uint32_t fresh = 0;
+    uint32_t count = 0;
+    uint32_t w;
+    uint32_t bits;
+    uint32_t i;
+
+    for(w = 0; w < BEACON_BMP_WORDS; w++)
     {
+        bits = beacon_valid[w];
+        while(bits)
+        {
+            i = (w << 5) + beacon_ctz32(bits);
+            bits &= bits - 1;
+            count++;
+            if(now - beacon_time_decode(beacon_tbl.update_time[i]) < (time_t)deadline)
+            {
+                fresh++;
+            }
+        }
+    }
+    *known = count;
+    return fresh;
+}
+
+// evict beacons not updated for BEACON_SILENCE_TIMEOUT seconds, call about once
+// per second, return number of evicted beacons
+uint32_t expire_stale_beacons(time_t now, beacon_evict_cb_t evict_cb)
+{
+    uint32_t evicted = 0;
+    uint32_t ticks;
+    uint32_t head;
+    uint32_t slot;
+    uint32_t next;
+    time_t deadline;
+
+    if(wheel_time == 0 || now < wheel_time)
+    {
+        wheel_time = now;
         return 0;
     }
-    if(i >= MAX_CONNECTED_BEACONS)
+
+    // after a long pause one revolution visits every bucket
+    ticks = (now - wheel_time > BEACON_WHEEL_SIZE) ? BEACON_WHEEL_SIZE : (uint32_t)(now - wheel_time);
+
+    while(ticks--)
     {
-        printf("Beacon device adding failed: maximum number of devices already connected\n");
-        return INVALID_U32;
+        wheel_time++;
+        head = WHEEL_HEAD((uint32_t)wheel_time & BEACON_WHEEL_MASK);
+
+        // detach the bucket, the last entry still links back to head
+        slot = wheel_next[head];
+        wheel_next[head] = (uint16_t)head;
+        wheel_prev[head] = (uint16_t)head;
+
+        while(slot != head)
+        {
+            next = wheel_next[slot];
+            deadline = beacon_time_decode(beacon_tbl.update_time[slot]) + BEACON_SILENCE_TIMEOUT;
+
+            wheel_insert(slot, deadline);
+            if(deadline <= now)
+            {
+                if(evict_cb)
+                {
+                    evict_cb(slot);
+                }
+                delete_beacon(slot);
+                evicted++;
+            }
+            slot = next;
+        }
     }
+    wheel_time = now;
 
-    beacon_tbl[i].element_used = 1u;
-    beacon_tbl[i].updated      = 1u;
+    return evicted;
+}
 
-    // TODO: real data
-    beacon_tbl[i].rstp      = INVALID_U32;
-    beacon_tbl[i].lat       = 65.0593177; // uni oulu
-    beacon_tbl[i].lon       = 25.4662935;
-    beacon_tbl[i].temp      = .0;
+#if BEACON_COMPACT_RECORDS
+// move time_base forward by shift seconds, timestamps older than the new base become 0
+static void rebase_beacon_times(time_t shift)
+{
+    uint32_t slot;
+    uint32_t i;
+    BEACON_HISTORY_REC_T *ring;
 
-    return 0;
+    time_base += shift;
+    for(slot = 0; slot < MAX_CONNECTED_BEACONS; slot++)
+    {
+        slot_write_begin(slot);
+        beacon_tbl.update_time[slot] = (beacon_tbl.update_time[slot] > shift) ?
+                                       (beacon_time_t)(beacon_tbl.update_time[slot] - shift) : 0;
+        ring = &history_slab[slot * BEACON_HISTORY_SIZE];
+        for(i = 0; i < BEACON_HISTORY_SIZE; i++)
+        {
+            ring[i].timestamp = (ring[i].timestamp > shift) ? (beacon_time_t)(ring[i].timestamp - shift) : 0;
+        }
+        slot_write_end(slot);
+    }
 }
+#endif
 
-void delete_beacon(uint8_t tbl_idx)
+// convert absolute time to the stored timestamp format, with compact records
+// the relative base is moved forward when t no longer fits in 16 bits
+beacon_time_t beacon_time_encode(time_t t)
 {
-    printf("Deleting beacon %u\n", tbl_idx);
-    memset(&(beacon_tbl[tbl_idx]), 0, sizeof(BEACON_DATA_T));
+#if BEACON_COMPACT_RECORDS
+    if(time_base == 0)
+    {
+        time_base = t - 1;
+    }
+    if(t <= time_base)
+    {
+        return 0;
+    }
+    if(t - time_base > 0xFFFF)
+    {
+        // keep the most recent half of the range
+        rebase_beacon_times(t - time_base - 0x7FFF);
+    }
+    return (beacon_time_t)(t - time_base);
+#else
+    return t;
+#endif
 }
 
-BEACON_DATA_T* get_beacon_tbl()
+time_t beacon_time_decode(beacon_time_t t)
 {
-    return beacon_tbl;
+#if BEACON_COMPACT_RECORDS
+    return t ? (time_base + (time_t)t) : 0;
+#else
+    return t;
+#endif
 }
 
-void dummy_update_beacon_data(uint8_t index)
+// static SRAM used by the registry, for footprint comparisons
+uint32_t get_beacon_registry_bytes()
 {
-    if(beacon_tbl[index].element_used)
+    return (uint32_t)(sizeof(beacon_tbl) + sizeof(beacon_hash) + sizeof(history_slab) +
+                      sizeof(free_slots) + sizeof(beacon_dirty) + sizeof(beacon_valid) +
+                      sizeof(wheel_next) + sizeof(wheel_prev));
+}
+
+static uint32_t image_checksum(uint32_t hash, const uint8_t *data, uint32_t len)
+{
+    while(len--)
     {
-        beacon_tbl[index].temp        = (beacon_tbl[index].temp < 50) ? (beacon_tbl[index].temp + 1.0) : 23.0;
-        beacon_tbl[index].updated     = 1;
-        beacon_tbl[index].update_time = time(NULL);
+        hash = (hash ^ *data++) * 16777619u;
+    }
+
+    return hash;
+}
+
+static void fill_image_header(BEACON_IMAGE_HDR_T *hdr)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic        = BEACON_IMAGE_MAGIC;
+    hdr->version      = BEACON_IMAGE_VERSION;
+    hdr->compact      = BEACON_COMPACT_RECORDS;
+    hdr->capacity     = MAX_CONNECTED_BEACONS;
+    hdr->history_size = BEACON_HISTORY_SIZE;
+    hdr->tbl_bytes    = sizeof(beacon_tbl);
+    hdr->slab_bytes   = sizeof(history_slab);
+}
+
+// size of the image written by save_beacon_registry()
+uint32_t get_beacon_image_size()
+{
+    return (uint32_t)(sizeof(BEACON_IMAGE_HDR_T) + sizeof(beacon_tbl) + sizeof(history_slab));
+}
+
+// write identity, last values and history of all beacons, return 1 if ok
+uint8_t save_beacon_registry(beacon_io_cb_t write_cb, void *ctx)
+{
+    BEACON_IMAGE_HDR_T hdr;
+
+    fill_image_header(&hdr);
+    hdr.checksum = image_checksum(2166136261u, (const uint8_t *)&beacon_tbl, sizeof(beacon_tbl));
+    hdr.checksum = image_checksum(hdr.checksum, (const uint8_t *)history_slab, sizeof(history_slab));
+#if BEACON_COMPACT_RECORDS
+    hdr.time_base = (int64_t)time_base;
+#endif
+
+    return (write_cb(ctx, &hdr, sizeof(hdr)) == 0) &&
+           (write_cb(ctx, &beacon_tbl, sizeof(beacon_tbl)) == 0) &&
+           (write_cb(ctx, history_slab, sizeof(history_slab)) == 0);
+}
+
+// Replace the registry with a saved image and rebuild the lookup structures.
+// Restored beacons count as seen now and are all marked dirty so the next
+// publish reports full state. Return number of restored beacons, 0 if the
+// image is missing, corrupt or from a different build (registry is then empty).
+uint32_t load_beacon_registry(beacon_io_cb_t read_cb, void *ctx)
+{
+    BEACON_IMAGE_HDR_T hdr;
+    BEACON_IMAGE_HDR_T expected;
+    beacon_time_t stamp;
+    time_t now = time(NULL);
+    uint32_t restored = 0;
+    uint32_t checksum;
+    uint32_t i;
+
+    init_beacon_tbl();
+    fill_image_header(&expected);
+
+    if(read_cb(ctx, &hdr, sizeof(hdr)) != 0 || hdr.magic != BEACON_IMAGE_MAGIC)
+    {
+        return 0;
+    }
+    expected.checksum  = hdr.checksum;
+    expected.time_base = hdr.time_base;
+    if(memcmp(&hdr, &expected, sizeof(hdr)) != 0)
+    {
+        printf("Beacon registry image does not match this build, ignoring it\n");
+        return 0;
+    }
+
+    // bulk of the image goes straight into the live tables
+    if((read_cb(ctx, &beacon_tbl, sizeof(beacon_tbl)) != 0) ||
+       (read_cb(ctx, history_slab, sizeof(history_slab)) != 0))
+    {
+        init_beacon_tbl();
+        return 0;
+    }
+    checksum = image_checksum(2166136261u, (const uint8_t *)&beacon_tbl, sizeof(beacon_tbl));
+    checksum = image_checksum(checksum, (const uint8_t *)history_slab, sizeof(history_slab));
+    if(checksum != hdr.checksum)
+    {
+        printf("Beacon registry image checksum mismatch, ignoring it\n");
+        init_beacon_tbl();
+        return 0;
+    }
+
+#if BEACON_COMPACT_RECORDS
+    time_base = (time_t)hdr.time_base;
+#endif
+    stamp = beacon_time_encode(now);
+
+    free_count = 0;
+    for(i = MAX_CONNECTED_BEACONS; i-- > 0; )
+    {
+        beacon_tbl.seq[i] = 0;
+        if(!beacon_tbl.info[i].element_used)
+        {
+            free_slots[free_count++] = (uint16_t)i;
+            continue;
+        }
+        beacon_hash[beacon_hash_probe(slot_key(i))] = (uint16_t)i;
+        beacon_valid[i >> 5] |= (0x1u << (i & 31u));
+        mark_dirty(i);
+        beacon_tbl.update_time[i] = stamp;
+        wheel_insert(i, now + BEACON_SILENCE_TIMEOUT);
+        restored++;
+    }
+    dummy_addr_counter = restored;
+    membership_gen++;
+
+    return restored;
+}
+
+BEACON_TBL_T* get_beacon_tbl()
+{
+    return &beacon_tbl;
+}
+
+// copy one beacon without tearing against a concurrent writer,
+// return 1 if ok, 0 if the slot is not in use
+uint8_t read_beacon_snapshot(uint32_t tbl_idx, BEACON_SNAPSHOT_T *snapshot)
+{
+    uint32_t seq_begin;
+    uint32_t seq_end;
+
+    if(tbl_idx >= MAX_CONNECTED_BEACONS)
+    {
+        return 0;
+    }
+
+    do
+    {
+        seq_begin = SEQ_LOAD_ACQUIRE(&beacon_tbl.seq[tbl_idx]);
+        if(seq_begin & 1u)
+        {
+            continue;
+        }
+        snapshot->temp        = BEACON_TEMP_TO_C(beacon_tbl.temp[tbl_idx]);
+        snapshot->rssi        = (beacon_tbl.rssi_avg[tbl_idx] == BEACON_RSSI_NONE) ? 0.0f :
+                                BEACON_RSSI_TO_DBM(beacon_tbl.rssi_avg[tbl_idx]);
+        snapshot->update_time = beacon_time_decode(beacon_tbl.update_time[tbl_idx]);
+        snapshot->info        = beacon_tbl.info[tbl_idx];
+        snapshot->link        = beacon_tbl.link[tbl_idx];
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        seq_end = SEQ_LOAD_RELAXED(&beacon_tbl.seq[tbl_idx]);
+    } while((seq_begin & 1u) || (seq_begin != seq_end));
+
+    return snapshot->info.element_used;
+}
+
+// copy up to max_samples most recent history samples of a beacon, oldest first,
+// return number of samples copied
+uint32_t read_beacon_history(uint32_t tbl_idx, BEACON_HISTORY_SAMPLE_T *samples, uint32_t max_samples)
+{
+    const BEACON_HISTORY_REC_T *ring;
+    uint32_t seq_begin;
+    uint32_t seq_end;
+    uint32_t count = 0;
+    uint32_t pos;
+    uint32_t i;
+
+    if(tbl_idx >= MAX_CONNECTED_BEACONS)
+    {
+        return 0;
+    }
+    ring = &history_slab[tbl_idx * BEACON_HISTORY_SIZE];
+
+    do
+    {
+        seq_begin = SEQ_LOAD_ACQUIRE(&beacon_tbl.seq[tbl_idx]);
+        if(seq_begin & 1u)
+        {
+            continue;
+        }
+        count = beacon_tbl.hist_count[tbl_idx];
+        if(count > max_samples)
+        {
+            count = max_samples;
+        }
+        // start count samples behind the write position
+        pos = (beacon_tbl.hist_head[tbl_idx] + BEACON_HISTORY_SIZE - count) % BEACON_HISTORY_SIZE;
+        for(i = 0; i < count; i++)
+        {
+            samples[i].timestamp = beacon_time_decode(ring[pos].timestamp);
+            samples[i].value     = BEACON_TEMP_TO_C(ring[pos].value);
+            pos = (pos + 1u < BEACON_HISTORY_SIZE) ? (pos + 1u) : 0u;
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        seq_end = SEQ_LOAD_RELAXED(&beacon_tbl.seq[tbl_idx]);
+    } while((seq_begin & 1u) || (seq_begin != seq_end));
+
+    return count;
+}
+
+uint8_t beacon_is_dirty(uint32_t tbl_idx)
+{
+    return (beacon_dirty[tbl_idx >> 5] >> (tbl_idx & 31u)) & 0x1u;
+}
+
+uint8_t beacon_is_valid(uint32_t tbl_idx)
+{
+    return (beacon_valid[tbl_idx >> 5] >> (tbl_idx & 31u)) & 0x1u;
+}
+
+// first slot >= from whose validity bit equals value, MAX_CONNECTED_BEACONS if none
+static uint32_t next_validity_change(uint32_t from, uint32_t value)
+{
+    uint32_t w = from >> 5;
+    uint32_t bits;
+
+    while(w < BEACON_BMP_WORDS)
+    {
+        bits = value ? beacon_valid[w] : ~beacon_valid[w];
+        if(w == (from >> 5))
+        {
+            bits &= ~0u << (from & 31u);
+        }
+        if(bits)
+        {
+            from = (w << 5) + beacon_ctz32(bits);
+            return (from < MAX_CONNECTED_BEACONS) ? from : MAX_CONNECTED_BEACONS;
+        }
+        w++;
+    }
+
+    return MAX_CONNECTED_BEACONS;
+}
+
+// append run as LEB128 varint, return new length or 0 if it does not fit
+static uint32_t put_varint(uint8_t *buf, uint32_t len, uint32_t buf_len, uint32_t run)
+{
+    do
+    {
+        if(len >= buf_len)
+        {
+            return 0;
+        }
+        buf[len++] = (uint8_t)((run & 0x7Fu) | ((run > 0x7Fu) ? 0x80u : 0u));
+        run >>= 7;
+    } while(run);
+
+    return len;
+}
+
+// encode validity bitmap into buf, return encoded length, 0 if buf is too small
+uint32_t encode_beacon_validity(uint8_t *buf, uint32_t buf_len)
+{
+    uint32_t raw_len = BEACON_BMP_MAX_ENCODED_LEN;
+    uint32_t len = 1;
+    uint32_t pos = 0;
+    uint32_t end;
+    uint32_t value = 0;
+    uint32_t i;
+
+    if(buf_len < 1)
+    {
+        return 0;
+    }
+
+    // try run-length first, give up as soon as it is not shorter than raw
+    buf[0] = BEACON_BMP_RLE;
+    while(pos < MAX_CONNECTED_BEACONS && len)
+    {
+        end = next_validity_change(pos, !value);
+        len = put_varint(buf, len, (buf_len < raw_len - 1) ? buf_len : raw_len - 1, end - pos);
+        pos = end;
+        value = !value;
+    }
+    if(len)
+    {
+        return len;
+    }
+
+    if(buf_len < raw_len)
+    {
+        return 0;
+    }
+    buf[0] = BEACON_BMP_RAW;
+    for(i = 0; i < raw_len - 1; i++)
+    {
+        buf[1 + i] = (uint8_t)(beacon_valid[i >> 2] >> ((i & 3u) * 8));
+    }
+
+    return raw_len;
+}
+
+// return one word of the dirty set and clear it, bit n <-> beacon_tbl[word_idx * 32 + n]
+uint32_t take_dirty_beacons(uint32_t word_idx)
+{
+    uint32_t bits = beacon_dirty[word_idx];
+
+    beacon_dirty[word_idx] = 0;
+    return bits;
+}
+
+void dummy_update_beacon_data(uint32_t index)
+{
+    if(index < MAX_CONNECTED_BEACONS && beacon_tbl.info[index].element_used)
+    {
+        float temp = BEACON_TEMP_TO_C(beacon_tbl.temp[index]);
+        beacon_time_t now = beacon_time_encode(time(NULL));
+
+        slot_write_begin(index);
+        beacon_tbl.temp[index]        = BEACON_TEMP_FROM_C((temp < 50) ? (temp + 1.0) : 23.0);
+        beacon_tbl.update_time[index] = now;
+        history_append(index, beacon_tbl.update_time[index], beacon_tbl.temp[index]);
+        slot_write_end(index);
+        mark_dirty(index);
     }
     else
     {
@@ -100,17 +794,188 @@ void dummy_update_beacon_data(uint8_t index)
     }
 }
 
-void update_beacon_data(uint8_t index, uint8_t temp)
+void update_beacon_data(uint32_t index, float temp)
 {
-    if(beacon_tbl[index].element_used)
+    if(index < MAX_CONNECTED_BEACONS && beacon_tbl.info[index].element_used)
     {
-        beacon_tbl[index].temp        = (float) temp;
-        beacon_tbl[index].updated     = 1;
-        beacon_tbl[index].update_time = time(NULL);
+        beacon_time_t now = beacon_time_encode(time(NULL));
+
+        slot_write_begin(index);
+        beacon_tbl.temp[index]        = BEACON_TEMP_FROM_C(temp);
+        beacon_tbl.update_time[index] = now;
+        history_append(index, beacon_tbl.update_time[index], beacon_tbl.temp[index]);
+        slot_write_end(index);
+        mark_dirty(index);
+    }
+    else
+    {
+        printf("update_beacon_data: Invalid device index %lu!\n", (unsigned long)index);
+    }
+}
+
+// fold one received signal strength into the beacon's moving average, the
+// first report after adding sets it directly
+void update_beacon_rssi(uint32_t index, int8_t rssi)
+{
+    int32_t x = (int32_t)rssi * (1 << BEACON_RSSI_FRAC_BITS);
+    int32_t avg;
+
+    if(index < MAX_CONNECTED_BEACONS && beacon_tbl.info[index].element_used)
+    {
+        avg = beacon_tbl.rssi_avg[index];
+        if(avg == BEACON_RSSI_NONE)
+        {
+            avg = x;
+        }
+        else
+        {
+            // round to nearest, a plain shift would settle up to 2^shift - 1 steps low
+            avg += (x - avg + (1 << (BEACON_RSSI_SHIFT - 1))) >> BEACON_RSSI_SHIFT;
+        }
+
+        slot_write_begin(index);
+        beacon_tbl.rssi_avg[index] = (int16_t)avg;
+        slot_write_end(index);
+        mark_dirty(index);
     }
     else
     {
-        printf("update_beacon_data: Invalid device index %d!\n", index);
+        printf("update_beacon_rssi: Invalid device index %lu!\n", (unsigned long)index);
     }
 }
 
+// Account one report carrying a rolling counter of seq_bits bits (8..32).
+// Only the last counter value is kept, so this is constant time: a late report
+// inside the window is taken as one of the values counted lost earlier.
+void update_beacon_seq(uint32_t index, uint32_t seq, uint8_t seq_bits)
+{
+    uint32_t mask = (seq_bits >= 32) ? 0xFFFFFFFFu : ((0x1u << seq_bits) - 1u);
+    BEACON_LINK_T link;
+    uint32_t ahead;
+    uint32_t behind;
+
+    if(index >= MAX_CONNECTED_BEACONS || !beacon_tbl.info[index].element_used)
+    {
+        printf("update_beacon_seq: Invalid device index %lu!\n", (unsigned long)index);
+        return;
+    }
+    if(seq_bits < 8)
+    {
+        return;
+    }
+
+    link = beacon_tbl.link[index];
+    seq &= mask;
+    ahead  = (seq - link.last_seq) & mask;
+    behind = (link.last_seq - seq) & mask;
+
+    if(link.seq_bits != seq_bits)
+    {
+        // first counter from this beacon, or it changed format
+        memset(&link, 0, sizeof(link));
+        link.seq_bits = seq_bits;
+        link.last_seq = seq;
+    }
+    else if(ahead == 0)
+    {
+        link.dups++;
+    }
+    else if(ahead <= BEACON_SEQ_WINDOW)
+    {
+        link.lost    += ahead - 1u;
+        link.last_seq = seq;
+    }
+    else if(behind <= BEACON_SEQ_WINDOW)
+    {
+        link.reorders++;
+        if(link.lost > 0)
+        {
+            link.lost--;
+        }
+    }
+    else
+    {
+        link.resyncs++;
+        link.last_seq = seq;
+    }
+    link.received++;
+
+    slot_write_begin(index);
+    beacon_tbl.link[index] = link;
+    slot_write_end(index);
+    mark_dirty(index);
+}
+
+// share of expected reports that arrived in percent, 0 if nothing was received
+float get_beacon_delivery_ratio(const BEACON_LINK_T *link)
+{
+    uint32_t delivered = link->received - link->dups;
+
+    if(link->received == 0)
+    {
+        return 0.0f;
+    }
+    return 100.0f * (float)delivered / (float)(delivered + link->lost);
+}
+
+// set the address type and advertisement format the beacon was seen with
+void set_beacon_source(uint32_t index, uint8_t addr_type, uint8_t format)
+{
+    if(index < MAX_CONNECTED_BEACONS && beacon_tbl.info[index].element_used)
+    {
+        slot_write_begin(index);
+        beacon_tbl.info[index].addr_type = addr_type;
+        beacon_tbl.info[index].format    = format;
+        slot_write_end(index);
+        membership_gen++;
+    }
+}
+
+// changes whenever a beacon is added, deleted or its address type changes
+uint32_t get_beacon_membership_gen()
+{
+    return membership_gen;
+}
+
+// fill entries with the distinct addresses of all beacons in the table,
+// return number of entries, INVALID_U32 if they do not fit in max_entries
+uint32_t get_beacon_accept_list(BEACON_ACCEPT_ENTRY_T *entries, uint32_t max_entries)
+{
+    uint32_t count = 0;
+    uint32_t w;
+    uint32_t bits;
+    uint32_t i;
+    uint32_t k;
+
+    for(w = 0; w < BEACON_BMP_WORDS; w++)
+    {
+        bits = beacon_valid[w];
+        while(bits)
+        {
+            i = (w << 5) + beacon_ctz32(bits);
+            bits &= bits - 1;
+
+            // one address may be tracked under several payload IDs
+            for(k = 0; k < count; k++)
+            {
+                if(entries[k].addr_type == beacon_tbl.info[i].addr_type &&
+                   memcmp(entries[k].addr, beacon_tbl.info[i].addr, BEACON_ADDR_LEN) == 0)
+                {
+                    break;
+                }
+            }
+            if(k < count)
+            {
+                continue;
+            }
+            if(count == max_entries)
+            {
+                return INVALID_U32;
+            }
+            memcpy(entries[count].addr, beacon_tbl.info[i].addr, BEACON_ADDR_LEN);
+            entries[count].addr_type = beacon_tbl.info[i].addr_type;
+            count++;
+        }
+    }
+    return count;
+}
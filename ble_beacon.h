@@ -1,26 +1,280 @@
+#ifndef BLE_BEACON_H
+#define BLE_BEACON_H
 
 #include <inttypes.h>
 #include <time.h>
 
+// maximum number of beacon records, override with "max-connected-beacons" in mbed_app.json
+#ifndef MAX_CONNECTED_BEACONS
 #define MAX_CONNECTED_BEACONS (10)
+#endif
 #define INVALID_U32           (0xFFFFFFFFu)
 
+#if MAX_CONNECTED_BEACONS > 0xFFFE
+#error "MAX_CONNECTED_BEACONS must fit in a 16-bit slot index"
+#endif
+
+#define BEACON_ADDR_LEN       (6)
+
+// round x up to the next power of two at compile time (1 <= x <= 2^32), also usable in #if
+#define BEACON_SMEAR_1(x)     ((x) | ((x) >> 1))
+#define BEACON_SMEAR_2(x)     (BEACON_SMEAR_1(x) | (BEACON_SMEAR_1(x) >> 2))
+#define BEACON_SMEAR_4(x)     (BEACON_SMEAR_2(x) | (BEACON_SMEAR_2(x) >> 4))
+#define BEACON_SMEAR_8(x)     (BEACON_SMEAR_4(x) | (BEACON_SMEAR_4(x) >> 8))
+#define BEACON_SMEAR_16(x)    (BEACON_SMEAR_8(x) | (BEACON_SMEAR_8(x) >> 16))
+#define BEACON_POW2_CEIL(x)   (BEACON_SMEAR_16((x) - 1u) + 1u)
+
+// open addressing index size, kept at <= 50% load so probe chains stay short
+#ifndef BEACON_HASH_SIZE
+#define BEACON_HASH_SIZE      BEACON_POW2_CEIL(2 * MAX_CONNECTED_BEACONS)
+#endif
+
+// a full probe table would make lookups of missing keys spin forever
+#if (BEACON_HASH_SIZE & (BEACON_HASH_SIZE - 1)) != 0 || BEACON_HASH_SIZE < 2 * MAX_CONNECTED_BEACONS
+#error "BEACON_HASH_SIZE must be a power of two and at least 2 * MAX_CONNECTED_BEACONS"
+#endif
+
+// samples kept per beacon between publish cycles,
+// override with "beacon-history-size" in mbed_app.json
+#ifndef BEACON_HISTORY_SIZE
+#define BEACON_HISTORY_SIZE   (8)
+#endif
+
+#if BEACON_HISTORY_SIZE < 1 || BEACON_HISTORY_SIZE > 0xFFFF
+#error "BEACON_HISTORY_SIZE must be in range 1..65535"
+#endif
+
+// seconds without updates after which a beacon is evicted,
+// override with "beacon-silence-timeout" in mbed_app.json
+#ifndef BEACON_SILENCE_TIMEOUT
+#define BEACON_SILENCE_TIMEOUT (60)
+#endif
+
+// buckets in the eviction timer wheel, one bucket per second, power of two
+#ifndef BEACON_WHEEL_SIZE
+#define BEACON_WHEEL_SIZE     (64)
+#endif
+
+#if (BEACON_WHEEL_SIZE & (BEACON_WHEEL_SIZE - 1)) != 0
+#error "BEACON_WHEEL_SIZE must be a power of two"
+#endif
+
+// RSSI smoothing, exponential moving average in 1/128 dBm updated per report as
+// avg += (rssi - avg) / 2^BEACON_RSSI_SHIFT, override with
+// "beacon-rssi-smoothing-shift" in mbed_app.json (1: fast, 7: slow)
+#ifndef BEACON_RSSI_SHIFT
+#define BEACON_RSSI_SHIFT     (3)
+#endif
+
+#if BEACON_RSSI_SHIFT < 1 || BEACON_RSSI_SHIFT > 7
+#error "BEACON_RSSI_SHIFT must be in range 1..7"
+#endif
+
+// fractional bits of the average, enough that rounding leaves at most
+// 2^(BEACON_RSSI_SHIFT - 1) / 128 dB of dead band and -128 dBm still fits int16
+#define BEACON_RSSI_FRAC_BITS (7)
+#define BEACON_RSSI_NONE      (INT16_MIN)
+#define BEACON_RSSI_TO_DBM(q) ((float)(q) / (float)(1 << BEACON_RSSI_FRAC_BITS))
+
+// Sequence tracking window, override with "beacon-seq-window" in mbed_app.json.
+// A counter step of up to this many forward counts the skipped values as lost,
+// a step of up to this many backward is a late (reordered) report. Larger steps
+// in either direction mean the beacon restarted its counter and tracking resyncs.
+#ifndef BEACON_SEQ_WINDOW
+#define BEACON_SEQ_WINDOW     (64)
+#endif
+
+#if BEACON_SEQ_WINDOW < 4 || BEACON_SEQ_WINDOW > 127
+#error "BEACON_SEQ_WINDOW must be in range 4..127"
+#endif
+
+// number of 32-bit words in a bitset with one bit per beacon slot
+#define BEACON_BMP_WORDS      ((MAX_CONNECTED_BEACONS + 31) / 32)
+
+// Validity bitmap encodings, first byte of the payload selects the format:
+//  BEACON_BMP_RAW: ceil(MAX_CONNECTED_BEACONS / 8) bytes, bit n of byte k <-> slot 8k + n
+//  BEACON_BMP_RLE: LEB128 varint run lengths covering all slots, alternating
+//                  invalid/valid runs starting with an invalid run (may be 0)
+// The encoder picks whichever is shorter, so the payload never exceeds
+// BEACON_BMP_MAX_ENCODED_LEN bytes.
+#define BEACON_BMP_RAW        (0x00u)
+#define BEACON_BMP_RLE        (0x01u)
+#define BEACON_BMP_MAX_ENCODED_LEN (1 + (MAX_CONNECTED_BEACONS + 7) / 8)
+
+// Compact records, enable with "beacon-compact-records" in mbed_app.json.
+// Temperatures are stored as int16 centi-degrees, coordinates as int32 in
+// 1e-7 degrees and timestamps as uint16 seconds relative to a base time that
+// is moved forward as time passes (see beacon_time_encode()). The public API
+// (update/snapshot/history) still takes and returns degrees and time_t.
+#ifndef BEACON_COMPACT_RECORDS
+#define BEACON_COMPACT_RECORDS (0)
+#endif
+
+#if BEACON_COMPACT_RECORDS
+typedef int16_t  beacon_temp_t;
+typedef int32_t  beacon_coord_t;
+typedef uint16_t beacon_time_t;
+#define BEACON_TEMP_FROM_C(c)   ((beacon_temp_t)((c) * 100.0f + (((c) < 0) ? -0.5f : 0.5f)))
+#define BEACON_TEMP_TO_C(t)     ((float)(t) / 100.0f)
+#define BEACON_COORD_FROM_DEG(d) ((beacon_coord_t)((d) * 1e7 + (((d) < 0) ? -0.5 : 0.5)))
+#define BEACON_COORD_TO_DEG(c)  ((float)((c) / 1e7))
+#else
+typedef float    beacon_temp_t;
+typedef float    beacon_coord_t;
+typedef time_t   beacon_time_t;
+#define BEACON_TEMP_FROM_C(c)   ((beacon_temp_t)(c))
+#define BEACON_TEMP_TO_C(t)     ((float)(t))
+#define BEACON_COORD_FROM_DEG(d) ((beacon_coord_t)(d))
+#define BEACON_COORD_TO_DEG(c)  ((float)(c))
+#endif
+
+#if BEACON_COMPACT_RECORDS
+#define BEACON_RSTP_INVALID     (INT8_MIN)
+#else
+#define BEACON_RSTP_INVALID     INVALID_U32
+#endif
+
+#if BEACON_COMPACT_RECORDS && BEACON_HISTORY_SIZE <= 0xFF
+typedef uint8_t  beacon_hist_idx_t;
+#else
+typedef uint16_t beacon_hist_idx_t;
+#endif
+
+// cold per-beacon data: identity and location, written once when the beacon is added
 typedef struct
 {
+#if BEACON_COMPACT_RECORDS
+    beacon_coord_t lat;    // latitude coordinate
+    beacon_coord_t lon;    // longitude coordinate
+    uint8_t addr[BEACON_ADDR_LEN]; // advertiser address, LSB first as reported by the stack
+    uint8_t id;            // payload ID of the beacon
+    uint8_t element_used : 1; // 0: free, 1: used
+    uint8_t addr_type    : 2; // advertiser address type as reported by the stack
+    uint8_t reserved     : 5;
+    int8_t rstp;           // received TX power from beacon device in dBm
+    uint8_t format;        // advertisement format, see ble_beacon_schema.h
+#else
     uint8_t element_used;  // 0: free, 1: used
-    uint8_t updated;       // range 0,1
-    time_t update_time;    // remove device when X amount of time with no updated?
+    uint8_t id;            // payload ID of the beacon
+    uint8_t addr[BEACON_ADDR_LEN]; // advertiser address, LSB first as reported by the stack
+    uint8_t format;        // advertisement format, see ble_beacon_schema.h
+    uint8_t addr_type;     // advertiser address type as reported by the stack
     uint32_t rstp;         // received TX power from beacon device TODO: format? dBm in sX.X FXP??
-    float lat;             // latitude coordinate
-    float lon;             // longitude coordinate
-    float temp;            // temperature in degrees celsius? TODO
-} BEACON_DATA_T;
+    beacon_coord_t lat;    // latitude coordinate
+    beacon_coord_t lon;    // longitude coordinate
+#endif
+} BEACON_INFO_T;
+
+// one timestamped reading in a beacon's history
+typedef struct
+{
+    time_t timestamp;
+    float value;
+} BEACON_HISTORY_SAMPLE_T;
+
+// history sample as stored, converted to BEACON_HISTORY_SAMPLE_T on read
+typedef struct
+{
+    beacon_time_t timestamp;
+    beacon_temp_t value;
+} BEACON_HISTORY_REC_T;
+
+// per-beacon delivery accounting from the payload sequence counter
+typedef struct
+{
+    uint32_t last_seq;     // highest counter value seen
+    uint32_t received;     // reports with a counter
+    uint32_t lost;         // counter values skipped and not received later
+    uint32_t dups;         // reports repeating the last counter value
+    uint32_t reorders;     // reports older than the last counter value
+    uint32_t resyncs;      // counter jumps outside BEACON_SEQ_WINDOW
+    uint8_t seq_bits;      // counter width, 0 until the first report with a counter
+} BEACON_LINK_T;
+
+// beacon table as struct-of-arrays, all arrays indexed by tbl index
+typedef struct
+{
+    // hot: written on every advertisement, read by the publisher
+    beacon_temp_t temp[MAX_CONNECTED_BEACONS];         // temperature, see BEACON_TEMP_TO_C()
+    beacon_time_t update_time[MAX_CONNECTED_BEACONS];  // last update, see beacon_time_decode()
+    uint32_t seq[MAX_CONNECTED_BEACONS];               // seqlock counter, odd while the slot is being written
+    beacon_hist_idx_t hist_head[MAX_CONNECTED_BEACONS];  // next write position in the slot's history ring
+    beacon_hist_idx_t hist_count[MAX_CONNECTED_BEACONS]; // valid samples in the slot's history ring
+    int16_t rssi_avg[MAX_CONNECTED_BEACONS];            // smoothed RSSI, see BEACON_RSSI_TO_DBM(), BEACON_RSSI_NONE if not heard
+    // cold
+    BEACON_INFO_T info[MAX_CONNECTED_BEACONS];
+    BEACON_LINK_T link[MAX_CONNECTED_BEACONS];
+} BEACON_TBL_T;
 
+// one entry of the controller filter accept list, see get_beacon_accept_list()
+typedef struct
+{
+    uint8_t addr[BEACON_ADDR_LEN];
+    uint8_t addr_type;
+} BEACON_ACCEPT_ENTRY_T;
 
-BEACON_DATA_T* get_beacon_tbl();
+// torn-free copy of one beacon, see read_beacon_snapshot()
+typedef struct
+{
+    float temp;
+    float rssi;            // smoothed RSSI in dBm, 0 if not heard yet
+    time_t update_time;
+    BEACON_INFO_T info;
+    BEACON_LINK_T link;
+} BEACON_SNAPSHOT_T;
+
+
+BEACON_TBL_T* get_beacon_tbl();
 uint32_t add_dummy_beacon();
-uint32_t add_beacon(uint8_t i);
+uint32_t add_beacon(const uint8_t addr[BEACON_ADDR_LEN], uint8_t id);
+uint32_t find_beacon(const uint8_t addr[BEACON_ADDR_LEN], uint8_t id);
 void init_beacon_tbl();
-void dummy_update_beacon_data(uint8_t index);
-void update_beacon_data(uint8_t index, uint8_t temp);
-void delete_beacon(uint8_t tbl_idx);
+void dummy_update_beacon_data(uint32_t index);
+void update_beacon_data(uint32_t index, float temp);
+void update_beacon_rssi(uint32_t index, int8_t rssi);
+void update_beacon_seq(uint32_t index, uint32_t seq, uint8_t seq_bits);
+float get_beacon_delivery_ratio(const BEACON_LINK_T *link);
+void set_beacon_source(uint32_t index, uint8_t addr_type, uint8_t format);
+uint32_t get_beacon_membership_gen();
+uint32_t get_beacon_accept_list(BEACON_ACCEPT_ENTRY_T *entries, uint32_t max_entries);
+void delete_beacon(uint32_t tbl_idx);
+uint8_t beacon_is_dirty(uint32_t tbl_idx);
+uint8_t beacon_is_valid(uint32_t tbl_idx);
+uint32_t encode_beacon_validity(uint8_t *buf, uint32_t buf_len);
+uint8_t read_beacon_snapshot(uint32_t tbl_idx, BEACON_SNAPSHOT_T *snapshot);
+uint32_t read_beacon_history(uint32_t tbl_idx, BEACON_HISTORY_SAMPLE_T *samples, uint32_t max_samples);
+uint32_t take_dirty_beacons(uint32_t word_idx);
+beacon_time_t beacon_time_encode(time_t t);
+time_t beacon_time_decode(beacon_time_t t);
+uint32_t get_beacon_registry_bytes();
+
+uint32_t count_fresh_beacons(time_t now, uint32_t deadline, uint32_t *known);
+
+// called for each evicted beacon before it is deleted
+typedef void (*beacon_evict_cb_t)(uint32_t tbl_idx);
+uint32_t expire_stale_beacons(time_t now, beacon_evict_cb_t evict_cb);
+
+// read or write len bytes of a registry image, return 0 on success
+typedef int (*beacon_io_cb_t)(void *ctx, void *data, uint32_t len);
+uint32_t get_beacon_image_size();
+uint8_t save_beacon_registry(beacon_io_cb_t write_cb, void *ctx);
+uint32_t load_beacon_registry(beacon_io_cb_t read_cb, void *ctx);
+
+// index of lowest set bit, x must be non-zero
+static inline uint32_t beacon_ctz32(uint32_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (uint32_t)__builtin_ctz(x);
+#else
+    uint32_t n = 0;
+
+    while((x & 1u) == 0)
+    {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+#endif // BLE_BEACON_H
@@ -0,0 +1,274 @@
+#include "ble_beacon_auth.h"
+
+#if BEACON_AUTH
+
+#include <stdio.h>
+#include <string.h>
+#include "mbedtls/ccm.h"
+#include "ble_adv_parser.h"
+#include "ble_beacon_schema.h"
+#include "ble_capture.h"
+
+#define AUTH_INDEX_SIZE       BEACON_POW2_CEIL(2 * BEACON_AUTH_KEYS)
+#define AUTH_INDEX_MASK       (AUTH_INDEX_SIZE - 1u)
+#define AUTH_SLOT_NONE        (0xFFu)
+
+#if BEACON_AUTH_KEYS > 0xFE
+#error "BEACON_AUTH_KEYS must fit in an 8-bit slot index"
+#endif
+
+typedef struct
+{
+    mbedtls_ccm_context ccm;   // keyed once, holds the expanded AES key
+    uint8_t addr[BEACON_ADDR_LEN];
+    uint8_t seen;              // a frame has been verified, last_counter is valid
+    uint32_t last_counter;
+} BEACON_AUTH_KEY_T;
+
+static BEACON_AUTH_KEY_T auth_keys[BEACON_AUTH_KEYS];
+static uint8_t auth_index[AUTH_INDEX_SIZE];
+static uint32_t auth_key_count;
+
+// written by the verifying context only, read elsewhere field by field
+static BEACON_AUTH_STATS_T auth_stats;
+#define AUTH_STAT_LOAD(f)     __atomic_load_n(&auth_stats.f, __ATOMIC_RELAXED)
+#define AUTH_STAT_ADD(f, v)   __atomic_store_n(&auth_stats.f, auth_stats.f + (v), __ATOMIC_RELAXED)
+static beacon_clock_us_t auth_clock_us;
+
+
+static uint32_t addr_hash(const uint8_t addr[BEACON_ADDR_LEN])
+{
+    uint32_t h = 2166136261u;
+    uint32_t i;
+
+    for(i = 0; i < BEACON_ADDR_LEN; i++)
+    {
+        h = (h ^ addr[i]) * 16777619u;
+    }
+    return h;
+}
+
+// index position holding addr, or the empty position where it would go
+static uint32_t auth_probe(const uint8_t addr[BEACON_ADDR_LEN])
+{
+    uint32_t pos = addr_hash(addr) & AUTH_INDEX_MASK;
+
+    while(auth_index[pos] != AUTH_SLOT_NONE &&
+          memcmp(auth_keys[auth_index[pos]].addr, addr, BEACON_ADDR_LEN) != 0)
+    {
+        pos = (pos + 1u) & AUTH_INDEX_MASK;
+    }
+    return pos;
+}
+
+void init_beacon_auth(beacon_clock_us_t clock_us)
+{
+    uint32_t i;
+
+    for(i = 0; i < auth_key_count; i++)
+    {
+        mbedtls_ccm_free(&auth_keys[i].ccm);
+    }
+    memset(auth_keys, 0, sizeof(auth_keys));
+    memset(auth_index, AUTH_SLOT_NONE, sizeof(auth_index));
+    memset(&auth_stats, 0, sizeof(auth_stats));
+    auth_key_count = 0;
+    auth_clock_us = clock_us;
+}
+
+// provision the key of one beacon, return its key slot, INVALID_U32 if the
+// table is full or the key is rejected
+uint32_t beacon_auth_add_key(const uint8_t addr[BEACON_ADDR_LEN], const uint8_t key[BEACON_AUTH_KEY_LEN])
+{
+    uint32_t pos = auth_probe(addr);
+    uint32_t slot = auth_index[pos];
+    BEACON_AUTH_KEY_T *k;
+
+    if(slot == AUTH_SLOT_NONE)
+    {
+        if(auth_key_count == BEACON_AUTH_KEYS)
+        {
+            printf("Beacon key adding failed: maximum number of keys already provisioned\n");
+            return INVALID_U32;
+        }
+        slot = auth_key_count;
+        k = &auth_keys[slot];
+        mbedtls_ccm_init(&k->ccm);
+        memcpy(k->addr, addr, BEACON_ADDR_LEN);
+    }
+    else
+    {
+        k = &auth_keys[slot];
+    }
+
+    if(mbedtls_ccm_setkey(&k->ccm, MBEDTLS_CIPHER_ID_AES, key, BEACON_AUTH_KEY_LEN * 8) != 0)
+    {
+        printf("beacon_auth_add_key: key setup failed\n");
+        if(auth_index[pos] == AUTH_SLOT_NONE)
+        {
+            mbedtls_ccm_free(&k->ccm);
+        }
+        return INVALID_U32;
+    }
+    k->seen = 0;
+    k->last_counter = 0;
+
+    if(auth_index[pos] == AUTH_SLOT_NONE)
+    {
+        auth_index[pos] = (uint8_t)slot;
+        auth_key_count++;
+    }
+    return slot;
+}
+
+uint8_t beacon_auth_has_key(const uint8_t addr[BEACON_ADDR_LEN])
+{
+    return auth_index[auth_probe(addr)] != AUTH_SLOT_NONE;
+}
+
+// key file line: "<address MSB first> <32 hex digits>", return 1 if parsed,
+// 0 for comments, blank and malformed lines
+uint8_t parse_beacon_auth_key_line(const char *line, uint8_t addr[BEACON_ADDR_LEN], uint8_t key[BEACON_AUTH_KEY_LEN])
+{
+    uint8_t msb_first[BEACON_ADDR_LEN];
+    const char *p = line;
+    uint32_t i;
+
+    while(*p == ' ' || *p == '\t')
+    {
+        p++;
+    }
+    if(*p == '#' || (p = parse_hex_bytes(p, msb_first, BEACON_ADDR_LEN, ':')) == NULL)
+    {
+        return 0;
+    }
+    if(*p != ' ' && *p != '\t')
+    {
+        return 0;
+    }
+    while(*p == ' ' || *p == '\t')
+    {
+        p++;
+    }
+    if((p = parse_hex_bytes(p, key, BEACON_AUTH_KEY_LEN, 0)) == NULL)
+    {
+        return 0;
+    }
+    while(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+    {
+        p++;
+    }
+    if(*p != '\0')
+    {
+        return 0;
+    }
+
+    for(i = 0; i < BEACON_ADDR_LEN; i++)
+    {
+        addr[i] = msb_first[BEACON_ADDR_LEN - 1 - i];
+    }
+    return 1;
+}
+
+// check one BEACON_TAG_AUTH frame against the advertiser's key
+static uint8_t verify_frame(const BEACON_RAW_REPORT_T *r)
+{
+    BLE_ADV_PAYLOAD_T payload;
+    BEACON_AUTH_KEY_T *k;
+    const uint8_t *v;
+    uint8_t nonce[BEACON_AUTH_NONCE_LEN];
+    uint8_t slot = auth_index[auth_probe(r->addr)];
+    uint32_t counter;
+
+    if(slot == AUTH_SLOT_NONE)
+    {
+        AUTH_STAT_ADD(no_key, 1u);
+        return 0;
+    }
+    k = &auth_keys[slot];
+
+    if(!ble_adv_find_payload(r->data, r->len, &payload) || payload.manufacturer.len < BEACON_AUTH_FRAME_LEN)
+    {
+        AUTH_STAT_ADD(bad_mic, 1u);
+        return 0;
+    }
+    v = payload.manufacturer.value;
+    counter = (uint32_t)v[BEACON_AUTH_COUNTER_OFF] | ((uint32_t)v[BEACON_AUTH_COUNTER_OFF + 1] << 8) |
+              ((uint32_t)v[BEACON_AUTH_COUNTER_OFF + 2] << 16) | ((uint32_t)v[BEACON_AUTH_COUNTER_OFF + 3] << 24);
+
+    // old counters are refused before spending an AES pass on them
+    if(k->seen && counter < k->last_counter)
+    {
+        AUTH_STAT_ADD(replayed, 1u);
+        return 0;
+    }
+
+    memset(nonce, 0, sizeof(nonce));
+    memcpy(nonce, r->addr, BEACON_ADDR_LEN);
+    memcpy(&nonce[BEACON_ADDR_LEN], &v[BEACON_AUTH_COUNTER_OFF], 4);
+    nonce[BEACON_ADDR_LEN + 4] = v[3];
+
+    if(mbedtls_ccm_auth_decrypt(&k->ccm, 0, nonce, sizeof(nonce), v, BEACON_AUTH_MIC_OFF,
+                                NULL, NULL, &v[BEACON_AUTH_MIC_OFF], BEACON_AUTH_MIC_LEN) != 0)
+    {
+        AUTH_STAT_ADD(bad_mic, 1u);
+        return 0;
+    }
+
+    k->seen = 1;
+    k->last_counter = counter;
+    AUTH_STAT_ADD(verified, 1u);
+    return 1;
+}
+
+// Verify the reports of one scan batch. Authenticated frames are checked
+// against the advertiser's key, plain frames pass unless the advertiser has a
+// key (a downgrade) or BEACON_AUTH_REQUIRED is set. Return the number of jobs
+// that passed, job->ok says which.
+uint32_t verify_beacon_auth_batch(BEACON_AUTH_JOB_T *jobs, uint32_t count)
+{
+    uint32_t start = auth_clock_us ? auth_clock_us() : 0;
+    uint32_t passed = 0;
+    uint32_t n;
+
+    if(count == 0)
+    {
+        return 0;
+    }
+
+    for(n = 0; n < count; n++)
+    {
+        if(jobs[n].format == BEACON_FMT_BEACON_TAG_AUTH)
+        {
+            jobs[n].ok = verify_frame(jobs[n].report);
+        }
+        else
+        {
+            jobs[n].ok = !BEACON_AUTH_REQUIRED && !beacon_auth_has_key(jobs[n].report->addr);
+            if(!jobs[n].ok)
+            {
+                AUTH_STAT_ADD(unauthenticated, 1u);
+            }
+        }
+        passed += jobs[n].ok;
+    }
+
+    AUTH_STAT_ADD(batches, 1u);
+    AUTH_STAT_ADD(total_us, auth_clock_us ? (auth_clock_us() - start) : 0);
+    return passed;
+}
+
+// copy of the verification statistics, counters are written by the verifying
+// context only, a copy taken elsewhere may be a few reports behind
+void get_beacon_auth_stats(BEACON_AUTH_STATS_T *stats)
+{
+    stats->verified        = AUTH_STAT_LOAD(verified);
+    stats->bad_mic         = AUTH_STAT_LOAD(bad_mic);
+    stats->replayed        = AUTH_STAT_LOAD(replayed);
+    stats->no_key          = AUTH_STAT_LOAD(no_key);
+    stats->unauthenticated = AUTH_STAT_LOAD(unauthenticated);
+    stats->batches         = AUTH_STAT_LOAD(batches);
+    stats->total_us        = AUTH_STAT_LOAD(total_us);
+}
+
+#endif // BEACON_AUTH
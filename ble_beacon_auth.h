@@ -0,0 +1,73 @@
+#ifndef BLE_BEACON_AUTH_H
+#define BLE_BEACON_AUTH_H
+
+#include <inttypes.h>
+#include "ble_scan_batch.h"
+
+// Authenticated beacon frames, enable with "beacon-auth" in mbed_app.json.
+// Needs mbedTLS with MBEDTLS_AES_C and MBEDTLS_CCM_C.
+#ifndef BEACON_AUTH
+#define BEACON_AUTH           (0)
+#endif
+
+// beacons with a provisioned key, override with "beacon-auth-keys" in mbed_app.json
+#ifndef BEACON_AUTH_KEYS
+#define BEACON_AUTH_KEYS      (16)
+#endif
+
+// drop every frame that is not authenticated, override with
+// "beacon-auth-required" in mbed_app.json
+#ifndef BEACON_AUTH_REQUIRED
+#define BEACON_AUTH_REQUIRED  (0)
+#endif
+
+#define BEACON_AUTH_KEY_LEN   (16)
+#define BEACON_AUTH_MIC_LEN   (4)
+
+// BEACON_TAG_AUTH manufacturer data, offsets into the AD value:
+//  0..1  company ID
+//  2     0xAE
+//  3     beacon ID
+//  4     temperature
+//  5..8  frame counter, little endian
+//  9..12 AES-CCM MIC over bytes 0..8, no encrypted part
+// The 13 byte nonce is the advertiser address (LSB first), the frame counter
+// and the beacon ID, zero padded. The counter must not go backwards; the same
+// frame repeated is accepted, an older one is rejected as a replay.
+#define BEACON_AUTH_COUNTER_OFF (5)
+#define BEACON_AUTH_MIC_OFF   (9)
+#define BEACON_AUTH_FRAME_LEN (BEACON_AUTH_MIC_OFF + BEACON_AUTH_MIC_LEN)
+#define BEACON_AUTH_NONCE_LEN (13)
+
+// one report waiting for verification, see verify_beacon_auth_batch()
+typedef struct
+{
+    const BEACON_RAW_REPORT_T *report;
+    uint8_t format;        // decoded format of the report
+    uint8_t ok;            // set by the verifier
+} BEACON_AUTH_JOB_T;
+
+typedef struct
+{
+    uint32_t verified;     // frames with a valid MIC
+    uint32_t bad_mic;      // MIC mismatch
+    uint32_t replayed;     // counter older than the last verified frame
+    uint32_t no_key;       // authenticated frame from a beacon without a key
+    uint32_t unauthenticated; // plain frame from a keyed beacon, or any with BEACON_AUTH_REQUIRED
+    uint32_t batches;
+    uint64_t total_us;     // time spent verifying
+} BEACON_AUTH_STATS_T;
+
+#if BEACON_AUTH
+// Keys are added before scanning starts, the scan batch processor then only
+// reads the table. Each key gets its CCM context set up once, so the AES key
+// schedule is expanded at provisioning and not per frame.
+void init_beacon_auth(beacon_clock_us_t clock_us);
+uint32_t beacon_auth_add_key(const uint8_t addr[BEACON_ADDR_LEN], const uint8_t key[BEACON_AUTH_KEY_LEN]);
+uint8_t beacon_auth_has_key(const uint8_t addr[BEACON_ADDR_LEN]);
+uint8_t parse_beacon_auth_key_line(const char *line, uint8_t addr[BEACON_ADDR_LEN], uint8_t key[BEACON_AUTH_KEY_LEN]);
+uint32_t verify_beacon_auth_batch(BEACON_AUTH_JOB_T *jobs, uint32_t count);
+void get_beacon_auth_stats(BEACON_AUTH_STATS_T *stats);
+#endif
+
+#endif // BLE_BEACON_AUTH_H
@@ -0,0 +1,163 @@
+#include <stddef.h>
+#include "ble_beacon_schema.h"
+
+#define VALUE_WIDTH(enc)      (((enc) == BEACON_VAL_S16_BE) ? 2u : 1u)
+#define MAX3(a, b, c)         ((a) > (b) ? ((a) > (c) ? (a) : (c)) : ((b) > (c) ? (b) : (c)))
+#define FIELD_END(off)        (((off) == BEACON_SCHEMA_NO_ID) ? 0u : (off) + 1u)
+
+// bytes of the sequence counter encodings, indexed by BEACON_SEQ_*
+static const uint8_t seq_width[] = { 0, 1, 2, 4, 4 };
+
+// switch key of a row, wildcard rows get a key no AD structure can produce
+#define SCHEMA_KEY(ad_type, uuid) (((uint32_t)(ad_type) << 16) | (uint32_t)(uuid))
+#define SCHEMA_ROW_KEY(name, ad_type, uuid) \
+    (((uuid) == BEACON_SCHEMA_ANY) ? (0x80000000u | BEACON_FMT_##name) : SCHEMA_KEY(ad_type, uuid))
+
+#define SCHEMA_ROW(name, ad_type, uuid, magic_off, magic, id_off, value_off, value_enc, scale, seq_off, seq_enc, \
+                   object_id, resource_id, res_name)                                                            \
+    { ad_type, uuid, magic_off, magic, id_off, value_off, value_enc,                                           \
+      MAX3((magic_off) + 1u, FIELD_END(id_off), (value_off) + VALUE_WIDTH(value_enc)),                         \
+      scale, seq_off, seq_enc, object_id, resource_id, res_name },
+
+#define SCHEMA_CASE(name, ad_type, uuid, ...) \
+    case SCHEMA_ROW_KEY(name, ad_type, uuid): return BEACON_FMT_##name;
+
+static const BEACON_SCHEMA_T beacon_schemas[BEACON_FMT_COUNT] =
+{
+    BEACON_SCHEMA_TABLE(SCHEMA_ROW)
+};
+
+
+const BEACON_SCHEMA_T* get_beacon_schema(uint8_t format)
+{
+    return (format < BEACON_FMT_COUNT) ? &beacon_schemas[format] : NULL;
+}
+
+// format registered for the company ID / service UUID, BEACON_FMT_COUNT if none
+static uint8_t schema_lookup(uint32_t key)
+{
+    switch(key)
+    {
+        BEACON_SCHEMA_TABLE(SCHEMA_CASE)
+        default:
+            return BEACON_FMT_COUNT;
+    }
+}
+
+// decode field with the given format, return 1 if the layout matches
+static uint8_t schema_decode(uint8_t format, const BLE_AD_FIELD_T *field, BEACON_READING_T *reading)
+{
+    const BEACON_SCHEMA_T *s = &beacon_schemas[format];
+    const uint8_t *v = field->value;
+    int32_t raw;
+
+    if(field->len < s->min_len || v[s->magic_off] != s->magic)
+    {
+        return 0;
+    }
+
+    switch(s->value_enc)
+    {
+        case BEACON_VAL_S8:
+            raw = (int8_t)v[s->value_off];
+            break;
+        case BEACON_VAL_S16_BE:
+            raw = (int16_t)(((uint16_t)v[s->value_off] << 8) | v[s->value_off + 1]);
+            break;
+        default:
+            raw = v[s->value_off];
+            break;
+    }
+
+    reading->format   = format;
+    reading->id       = (s->id_off == BEACON_SCHEMA_NO_ID) ? 0 : v[s->id_off];
+    reading->value    = (float)raw * s->scale;
+    reading->seq_bits = 0;
+    reading->seq      = 0;
+
+    // optional counter, only if the frame is long enough to hold it
+    if(s->seq_enc != BEACON_SEQ_NONE && (uint32_t)s->seq_off + seq_width[s->seq_enc] <= field->len)
+    {
+        v += s->seq_off;
+        switch(s->seq_enc)
+        {
+            case BEACON_SEQ_U16_BE:
+                reading->seq = ((uint32_t)v[0] << 8) | v[1];
+                break;
+            case BEACON_SEQ_U32_BE:
+                reading->seq = ((uint32_t)v[0] << 24) | ((uint32_t)v[1] << 16) | ((uint32_t)v[2] << 8) | v[3];
+                break;
+            case BEACON_SEQ_U32_LE:
+                reading->seq = ((uint32_t)v[3] << 24) | ((uint32_t)v[2] << 16) | ((uint32_t)v[1] << 8) | v[0];
+                break;
+            default:
+                reading->seq = v[0];
+                break;
+        }
+        reading->seq_bits = (uint8_t)(seq_width[s->seq_enc] * 8u);
+    }
+    return 1;
+}
+
+static uint8_t decode_field(const BLE_AD_FIELD_T *field, BEACON_READING_T *reading)
+{
+    uint8_t format;
+
+    if(field->len < 2)
+    {
+        return 0;
+    }
+
+    format = schema_lookup(SCHEMA_KEY(field->type, field->value[0] | ((uint32_t)field->value[1] << 8)));
+    if(format < BEACON_FMT_COUNT && schema_decode(format, field, reading))
+    {
+        return 1;
+    }
+
+    for(format = 0; format < BEACON_FMT_COUNT; format++)
+    {
+        if(beacon_schemas[format].uuid == BEACON_SCHEMA_ANY &&
+           beacon_schemas[format].ad_type == field->type &&
+           schema_decode(format, field, reading))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#if BEACON_LEGACY_TAG
+// fixed offset tag frame of the original firmware, see BEACON_LEGACY_TAG_OFFSET
+static uint8_t decode_legacy_tag(const uint8_t *data, uint32_t data_len, BEACON_READING_T *reading)
+{
+    if(data_len < BEACON_LEGACY_MIN_LEN ||
+       data[BEACON_LEGACY_TAG_OFFSET] != beacon_schemas[BEACON_FMT_BEACON_TAG].magic)
+    {
+        return 0;
+    }
+
+    reading->format   = BEACON_FMT_BEACON_TAG;
+    reading->id       = data[BEACON_LEGACY_ID_OFFSET];
+    reading->value    = (float)data[BEACON_LEGACY_VALUE_OFFSET] * beacon_schemas[BEACON_FMT_BEACON_TAG].scale;
+    reading->seq_bits = 0;
+    reading->seq      = 0;
+    return 1;
+}
+#endif
+
+// decode advertisement with the first matching format, return 1 if one matched
+uint8_t decode_beacon_adv(const uint8_t *data, uint32_t data_len, BEACON_READING_T *reading)
+{
+    BLE_ADV_PAYLOAD_T payload;
+
+    if(ble_adv_find_payload(data, data_len, &payload) &&
+       (decode_field(&payload.manufacturer, reading) || decode_field(&payload.service_data, reading)))
+    {
+        return 1;
+    }
+#if BEACON_LEGACY_TAG
+    return decode_legacy_tag(data, data_len, reading);
+#else
+    return 0;
+#endif
+}
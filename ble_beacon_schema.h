@@ -0,0 +1,104 @@
+#ifndef BLE_BEACON_SCHEMA_H
+#define BLE_BEACON_SCHEMA_H
+
+#include <inttypes.h>
+#include "ble_adv_parser.h"
+
+// uuid column value matching any company ID / service UUID, such rows are
+// recognised by their magic byte alone and tried after the keyed rows
+#define BEACON_SCHEMA_ANY     (0x10000u)
+// id_off column value for formats without a beacon ID, the ID is then 0
+#define BEACON_SCHEMA_NO_ID   (0xFFu)
+
+// value encodings
+#define BEACON_VAL_U8         (0u)
+#define BEACON_VAL_S8         (1u)
+#define BEACON_VAL_S16_BE     (2u)
+
+// rolling sequence counter encodings, BEACON_SEQ_NONE if the format has none
+#define BEACON_SEQ_NONE       (0u)
+#define BEACON_SEQ_U8         (1u)
+#define BEACON_SEQ_U16_BE     (2u)
+#define BEACON_SEQ_U32_BE     (3u)
+#define BEACON_SEQ_U32_LE     (4u)
+
+// Supported advertisement formats, one row per format:
+//  X(name, ad_type, uuid, magic_off, magic, id_off, value_off, value_enc, scale, seq_off, seq_enc, object_id, resource_id, res_name)
+// ad_type is BLE_AD_TYPE_MANUFACTURER_DATA (uuid = company ID) or
+// BLE_AD_TYPE_SERVICE_DATA_16 (uuid = service UUID). Offsets index the AD
+// value, so the 16-bit company ID / UUID is at 0..1. The decoded value is
+// raw * scale and is published on object_id/<slot>/resource_id, named
+// beacon_<slot>_<res_name>. The sequence counter is optional in the frame:
+// it is decoded only if the AD value reaches past it, so tag beacons may
+// append a counter byte to the original 5 byte frame.
+// Adding a format is adding a row, the first row is the default for beacons
+// added without a format (e.g. dummy beacons). BEACON_TAG_AUTH frames carry a
+// counter and MIC after the value and only count once verified, see
+// ble_beacon_auth.h.
+#define BEACON_SCHEMA_TABLE(X) \
+    X(BEACON_TAG,      BLE_AD_TYPE_MANUFACTURER_DATA, BEACON_SCHEMA_ANY, 2, 0xAF, 3,                   4,  BEACON_VAL_U8,     1.0f,           5,  BEACON_SEQ_U8,     3303, 5700, "temperature") \
+    X(BEACON_TAG_SVC,  BLE_AD_TYPE_SERVICE_DATA_16,   BEACON_SCHEMA_ANY, 2, 0xAF, 3,                   4,  BEACON_VAL_U8,     1.0f,           5,  BEACON_SEQ_U8,     3303, 5700, "temperature") \
+    X(BEACON_TAG_AUTH, BLE_AD_TYPE_MANUFACTURER_DATA, BEACON_SCHEMA_ANY, 2, 0xAE, 3,                   4,  BEACON_VAL_U8,     1.0f,           5,  BEACON_SEQ_U32_LE, 3303, 5700, "temperature") \
+    X(IBEACON,         BLE_AD_TYPE_MANUFACTURER_DATA, 0x004C,            2, 0x02, 23,                  24, BEACON_VAL_S8,     1.0f,           0,  BEACON_SEQ_NONE,   3300, 5700, "measured_power") \
+    X(EDDYSTONE_TLM,   BLE_AD_TYPE_SERVICE_DATA_16,   0xFEAA,            2, 0x20, BEACON_SCHEMA_NO_ID, 6,  BEACON_VAL_S16_BE, 1.0f / 256.0f,  8,  BEACON_SEQ_U32_BE, 3303, 5700, "temperature") \
+    X(RUUVI_RAWV2,     BLE_AD_TYPE_MANUFACTURER_DATA, 0x0499,            2, 0x05, BEACON_SCHEMA_NO_ID, 3,  BEACON_VAL_S16_BE, 0.005f,         18, BEACON_SEQ_U16_BE, 3303, 5700, "temperature")
+
+// Layout read by the original firmware: tag, ID and value at fixed offsets of
+// the raw advertising data, in whatever AD structure they fall. With
+// BEACON_LEGACY_TAG set, frames no row matches are still decoded this way as
+// BEACON_TAG so tags deployed against that firmware keep working. Any
+// advertiser with 0xAF at offset 10 passes this check, turn it off with
+// "beacon-legacy-tag" in mbed_app.json once the tags are updated.
+#ifndef BEACON_LEGACY_TAG
+#define BEACON_LEGACY_TAG          (1)
+#endif
+// authenticated builds accept no frame that any advertiser can imitate
+#if BEACON_LEGACY_TAG && defined(BEACON_AUTH) && BEACON_AUTH
+#undef BEACON_LEGACY_TAG
+#define BEACON_LEGACY_TAG          (0)
+#endif
+#define BEACON_LEGACY_TAG_OFFSET   (10)
+#define BEACON_LEGACY_ID_OFFSET    (11)
+#define BEACON_LEGACY_VALUE_OFFSET (12)
+#define BEACON_LEGACY_MIN_LEN      (14)
+
+#define BEACON_SCHEMA_ENUM(name, ...) BEACON_FMT_##name,
+typedef enum
+{
+    BEACON_SCHEMA_TABLE(BEACON_SCHEMA_ENUM)
+    BEACON_FMT_COUNT
+} beacon_format_t;
+#undef BEACON_SCHEMA_ENUM
+
+typedef struct
+{
+    uint8_t ad_type;
+    uint32_t uuid;
+    uint8_t magic_off;
+    uint8_t magic;
+    uint8_t id_off;
+    uint8_t value_off;
+    uint8_t value_enc;
+    uint8_t min_len;       // shortest AD value holding all fields
+    float scale;
+    uint8_t seq_off;
+    uint8_t seq_enc;
+    uint16_t object_id;    // LwM2M object the value is published on
+    uint16_t resource_id;  // LwM2M resource in that object
+    const char *res_name;
+} BEACON_SCHEMA_T;
+
+// one decoded advertisement
+typedef struct
+{
+    uint8_t format;        // beacon_format_t
+    uint8_t id;
+    uint8_t seq_bits;      // width of the sequence counter, 0 if the frame carries none
+    uint32_t seq;
+    float value;
+} BEACON_READING_T;
+
+const BEACON_SCHEMA_T* get_beacon_schema(uint8_t format);
+uint8_t decode_beacon_adv(const uint8_t *data, uint32_t data_len, BEACON_READING_T *reading);
+
+#endif // BLE_BEACON_SCHEMA_H
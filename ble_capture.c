@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ble_capture.h"
+
+static int hex_nibble(char c)
+{
+    if(c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if(c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if(c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// parse n hex bytes, separated by sep if non-zero, return pointer past them or NULL
+const char* parse_hex_bytes(const char *p, uint8_t *out, uint32_t n, char sep)
+{
+    uint32_t i;
+    int hi;
+    int lo;
+
+    for(i = 0; i < n; i++)
+    {
+        hi = hex_nibble(p[0]);
+        lo = (hi < 0) ? -1 : hex_nibble(p[1]);
+        if(lo < 0)
+        {
+            return NULL;
+        }
+        out[i] = (uint8_t)((hi << 4) | lo);
+        p += 2;
+        if(sep && i < n - 1)
+        {
+            if(*p != sep)
+            {
+                return NULL;
+            }
+            p++;
+        }
+    }
+    return p;
+}
+
+static const char* skip_space(const char *p)
+{
+    while(*p == ' ' || *p == '\t')
+    {
+        p++;
+    }
+    return p;
+}
+
+// parse decimal integer field, return pointer past it or NULL
+static const char* parse_int(const char *p, long min, long max, long *value)
+{
+    char *end;
+
+    *value = strtol(p, &end, 10);
+    if(end == p || *value < min || *value > max)
+    {
+        return NULL;
+    }
+    return end;
+}
+
+// parse one capture line, return 1 if rec is set, 0 for comments, blank and malformed lines
+uint8_t parse_capture_line(const char *line, BEACON_CAPTURE_REC_T *rec)
+{
+    uint8_t msb_first[BEACON_ADDR_LEN];
+    const char *p = skip_space(line);
+    long value;
+    int hi;
+    int lo;
+    uint32_t i;
+
+    if(*p == '\0' || *p == '\n' || *p == '\r' || *p == '#')
+    {
+        return 0;
+    }
+
+    if((p = parse_int(p, 0, 0x7FFFFFFFL, &value)) == NULL)
+    {
+        return 0;
+    }
+    rec->time_ms = (uint32_t)value;
+
+    // address, most significant byte first
+    p = skip_space(p);
+    if((p = parse_hex_bytes(p, msb_first, BEACON_ADDR_LEN, ':')) == NULL)
+    {
+        return 0;
+    }
+    for(i = 0; i < BEACON_ADDR_LEN; i++)
+    {
+        rec->report.addr[i] = msb_first[BEACON_ADDR_LEN - 1 - i];
+    }
+
+    if((p = parse_int(skip_space(p), 0, 3, &value)) == NULL)
+    {
+        return 0;
+    }
+    rec->report.addr_type = (uint8_t)value;
+    if((p = parse_int(skip_space(p), -128, 127, &value)) == NULL)
+    {
+        return 0;
+    }
+    rec->report.rssi = (int8_t)value;
+    if((p = parse_int(skip_space(p), 0, BEACON_PHY_COUNT - 1, &value)) == NULL)
+    {
+        return 0;
+    }
+    rec->report.phy = (uint8_t)value;
+
+    // payload
+    p = skip_space(p);
+    for(i = 0; (hi = hex_nibble(p[0])) >= 0; i++)
+    {
+        lo = hex_nibble(p[1]);
+        if(lo < 0 || i == BEACON_ADV_DATA_MAX)
+        {
+            return 0;
+        }
+        rec->report.data[i] = (uint8_t)((hi << 4) | lo);
+        p += 2;
+    }
+    rec->report.len = (uint8_t)i;
+
+    p = skip_space(p);
+    return (*p == '\0' || *p == '\n' || *p == '\r') ? 1 : 0;
+}
+
+// write rec as a capture line with trailing newline, return its length,
+// 0 if buf is too small
+uint32_t format_capture_line(const BEACON_CAPTURE_REC_T *rec, char *buf, uint32_t buf_len)
+{
+    const BEACON_RAW_REPORT_T *r = &rec->report;
+    int n;
+    uint32_t i;
+
+    n = snprintf(buf, buf_len, "%lu %02x:%02x:%02x:%02x:%02x:%02x %u %d %u ",
+                 (unsigned long)rec->time_ms,
+                 r->addr[5], r->addr[4], r->addr[3], r->addr[2], r->addr[1], r->addr[0],
+                 r->addr_type, r->rssi, r->phy);
+    if(n < 0 || (uint32_t)n + 2u * r->len + 2u > buf_len)
+    {
+        return 0;
+    }
+    for(i = 0; i < r->len; i++)
+    {
+        n += snprintf(buf + n, buf_len - n, "%02x", r->data[i]);
+    }
+    buf[n++] = '\n';
+    buf[n] = '\0';
+
+    return (uint32_t)n;
+}
@@ -0,0 +1,29 @@
+#ifndef BLE_CAPTURE_H
+#define BLE_CAPTURE_H
+
+#include <inttypes.h>
+#include "ble_scan_batch.h"
+
+// Advertisement capture, one report per text line:
+//   <time ms> <address> <address type> <rssi> <phy> <payload hex>
+// e.g.
+//   1250 c0:00:00:00:01:02 1 -67 0 02010606ff5900af0715
+// Time is relative to the start of the capture, the address is written most
+// significant byte first, phy is a BEACON_PHY_* value. Blank lines and lines
+// starting with '#' are ignored.
+#define BEACON_CAPTURE_LINE_MAX (64 + 2 * BEACON_ADV_DATA_MAX)
+
+typedef struct
+{
+    uint32_t time_ms;
+    BEACON_RAW_REPORT_T report;
+} BEACON_CAPTURE_REC_T;
+
+uint8_t parse_capture_line(const char *line, BEACON_CAPTURE_REC_T *rec);
+uint32_t format_capture_line(const BEACON_CAPTURE_REC_T *rec, char *buf, uint32_t buf_len);
+
+// n hex bytes, separated by sep if non-zero (e.g. ':' in addresses), also
+// used by the beacon key file parser
+const char* parse_hex_bytes(const char *p, uint8_t *out, uint32_t n, char sep);
+
+#endif // BLE_CAPTURE_H
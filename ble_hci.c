@@ -0,0 +1,211 @@
+#include <string.h>
+#if defined(__linux__)
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+#include "ble_hci.h"
+
+static uint16_t get_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static uint32_t build_command(uint8_t *buf, uint16_t opcode, uint8_t param_len)
+{
+    buf[0] = BLE_HCI_COMMAND_PKT;
+    put_le16(&buf[1], opcode);
+    buf[3] = param_len;
+    return 4u + param_len;
+}
+
+// LE Set Scan Parameters, interval and window in 0.625 ms units, own address public
+uint32_t ble_hci_build_set_scan_params(uint8_t *buf, uint8_t active, uint16_t interval, uint16_t window,
+                                       uint8_t filter_policy)
+{
+    buf[4] = active ? 0x01 : 0x00;
+    put_le16(&buf[5], interval);
+    put_le16(&buf[7], window);
+    buf[9] = 0x00;
+    buf[10] = filter_policy;
+    return build_command(buf, BLE_HCI_OP_LE_SET_SCAN_PARAMS, 7);
+}
+
+uint32_t ble_hci_build_set_scan_enable(uint8_t *buf, uint8_t enable, uint8_t filter_duplicates)
+{
+    buf[4] = enable ? 0x01 : 0x00;
+    buf[5] = filter_duplicates ? 0x01 : 0x00;
+    return build_command(buf, BLE_HCI_OP_LE_SET_SCAN_ENABLE, 2);
+}
+
+// LE Advertising Report subevent, reports are laid out one after the other:
+// event type, address type, address, data length, data, rssi
+static uint32_t queue_adv_reports(BLE_HCI_RX_T *rx, const uint8_t *p, uint32_t len)
+{
+    BEACON_RAW_REPORT_T *report;
+    uint32_t num;
+    uint32_t queued = 0;
+    uint8_t data_len;
+
+    if(len < 1)
+    {
+        rx->errors++;
+        return 0;
+    }
+    num = p[0];
+    p++;
+    len--;
+
+    while(num--)
+    {
+        if(len < 9 || len < 10u + p[8])
+        {
+            rx->errors++;
+            break;
+        }
+        data_len = p[8];
+
+        report = reserve_scan_report();
+        if(report != NULL)
+        {
+            report->addr_type = p[1];
+            memcpy(report->addr, &p[2], BEACON_ADDR_LEN);
+            report->len = (data_len < BEACON_ADV_DATA_MAX) ? data_len : BEACON_ADV_DATA_MAX;
+            memcpy(report->data, &p[9], report->len);
+            report->rssi = (int8_t)p[9 + data_len];
+            report->phy = BEACON_PHY_1M;
+            commit_scan_report();
+            queued++;
+        }
+        p += 10u + data_len;
+        len -= 10u + data_len;
+    }
+
+    rx->adv_reports += queued;
+    return queued;
+}
+
+// handle one complete event packet, buf[0] is the indicator
+static uint32_t handle_event(BLE_HCI_RX_T *rx, const uint8_t *pkt)
+{
+    const uint8_t *param = &pkt[3];
+    uint8_t param_len = pkt[2];
+
+    rx->events++;
+    switch(pkt[1])
+    {
+        case BLE_HCI_EVT_LE_META:
+            if(param_len >= 1 && param[0] == BLE_HCI_LE_ADV_REPORT)
+            {
+                return queue_adv_reports(rx, &param[1], param_len - 1u);
+            }
+            break;
+        case BLE_HCI_EVT_CMD_COMPLETE:
+            // num packets, opcode, status
+            if(param_len >= 4)
+            {
+                rx->cmd_opcode = get_le16(&param[1]);
+                rx->cmd_status = param[3];
+                rx->cmd_count++;
+            }
+            break;
+        case BLE_HCI_EVT_CMD_STATUS:
+            // status, num packets, opcode
+            if(param_len >= 4)
+            {
+                rx->cmd_status = param[0];
+                rx->cmd_opcode = get_le16(&param[2]);
+                rx->cmd_count++;
+            }
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+void ble_hci_rx_init(BLE_HCI_RX_T *rx)
+{
+    memset(rx, 0, sizeof(*rx));
+}
+
+// append stream bytes and handle every packet completed by them,
+// return the number of advertising reports queued
+uint32_t ble_hci_rx_feed(BLE_HCI_RX_T *rx, const uint8_t *data, uint32_t len)
+{
+    uint32_t queued = 0;
+    uint32_t n;
+
+    while(len > 0)
+    {
+        // anything but an event indicator is out of sync, skip it
+        if(rx->len == 0 && data[0] != BLE_HCI_EVENT_PKT)
+        {
+            rx->errors++;
+            data++;
+            len--;
+            continue;
+        }
+
+        // header first, then as much of the parameters as the header announces
+        n = (rx->len < 3) ? 3u - rx->len : 3u + rx->buf[2] - rx->len;
+        if(n > len)
+        {
+            n = len;
+        }
+        memcpy(&rx->buf[rx->len], data, n);
+        rx->len += n;
+        data += n;
+        len -= n;
+
+        if(rx->len >= 3 && rx->len == 3u + rx->buf[2])
+        {
+            queued += handle_event(rx, rx->buf);
+            rx->len = 0;
+        }
+    }
+
+    return queued;
+}
+
+#if defined(__linux__)
+uint32_t ble_hci_rx_poll(BLE_HCI_RX_T *rx, int fd, int timeout_ms)
+{
+    uint8_t buf[BLE_HCI_EVENT_MAX];
+    struct pollfd pfd;
+    ssize_t n;
+    int ret;
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    ret = poll(&pfd, 1, timeout_ms);
+    if(ret == 0 || (ret < 0 && errno == EINTR))
+    {
+        return 0;
+    }
+    if(ret < 0)
+    {
+        return INVALID_U32;
+    }
+
+    n = read(fd, buf, sizeof(buf));
+    if(n < 0 && (errno == EAGAIN || errno == EINTR))
+    {
+        return 0;
+    }
+    if(n <= 0)
+    {
+        return INVALID_U32;
+    }
+
+    return ble_hci_rx_feed(rx, buf, (uint32_t)n);
+}
+#endif
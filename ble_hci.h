@@ -0,0 +1,57 @@
+#ifndef BLE_HCI_H
+#define BLE_HCI_H
+
+#include <inttypes.h>
+#include "ble_scan_batch.h"
+
+// HCI UART/socket packet indicators
+#define BLE_HCI_COMMAND_PKT   (0x01)
+#define BLE_HCI_EVENT_PKT     (0x04)
+
+#define BLE_HCI_EVT_CMD_COMPLETE (0x0E)
+#define BLE_HCI_EVT_CMD_STATUS   (0x0F)
+#define BLE_HCI_EVT_LE_META      (0x3E)
+#define BLE_HCI_LE_ADV_REPORT    (0x02)
+
+// LE controller commands, OGF 0x08
+#define BLE_HCI_OPCODE(ogf, ocf) ((uint16_t)(((ogf) << 10) | (ocf)))
+#define BLE_HCI_OP_LE_SET_SCAN_PARAMS BLE_HCI_OPCODE(0x08, 0x000B)
+#define BLE_HCI_OP_LE_SET_SCAN_ENABLE BLE_HCI_OPCODE(0x08, 0x000C)
+
+// indicator, event code, parameter length and up to 255 parameter bytes
+#define BLE_HCI_EVENT_MAX     (3 + 255)
+#define BLE_HCI_COMMAND_MAX   (4 + 255)
+
+// Reassembles HCI event packets from a byte stream. A raw HCI socket hands
+// over one packet per read, a UART or a test stream may split or join them,
+// so bytes are buffered until the packet is complete. LE Advertising Report
+// events are copied straight into the scan report ring, Command Complete and
+// Command Status are remembered for the command that is waiting on them,
+// other events are skipped.
+typedef struct
+{
+    uint8_t buf[BLE_HCI_EVENT_MAX];
+    uint32_t len;
+    uint32_t events;       // complete event packets seen
+    uint32_t adv_reports;  // advertising reports queued
+    uint32_t errors;       // bytes skipped to resync and malformed reports
+    uint32_t cmd_count;    // Command Complete/Status events seen
+    uint16_t cmd_opcode;   // opcode of the last Command Complete/Status
+    uint8_t cmd_status;    // its status, 0 on success
+} BLE_HCI_RX_T;
+
+void ble_hci_rx_init(BLE_HCI_RX_T *rx);
+uint32_t ble_hci_rx_feed(BLE_HCI_RX_T *rx, const uint8_t *data, uint32_t len);
+
+// build command packets into buf (BLE_HCI_COMMAND_MAX bytes), return the packet length
+uint32_t ble_hci_build_set_scan_params(uint8_t *buf, uint8_t active, uint16_t interval, uint16_t window,
+                                       uint8_t filter_policy);
+uint32_t ble_hci_build_set_scan_enable(uint8_t *buf, uint8_t enable, uint8_t filter_duplicates);
+
+#if defined(__linux__)
+// wait up to timeout_ms for data on fd and feed it to rx, return the number
+// of advertising reports queued, INVALID_U32 on EOF or error
+uint32_t ble_hci_rx_poll(BLE_HCI_RX_T *rx, int fd, int timeout_ms);
+#endif
+
+#endif // BLE_HCI_H
@@ -0,0 +1,95 @@
+#include "ble_report_policy.h"
+
+// 1 if value is outside the deadband around the last reported value
+static uint8_t report_policy_exceeds(const BEACON_REPORT_POLICY_T *policy, const BEACON_REPORT_STATE_T *state,
+                                     float value)
+{
+    float change = value - state->last_value;
+    float band = policy->rel_deadband * state->last_value;
+
+    if(change < 0)
+    {
+        change = -change;
+    }
+    if(band < 0)
+    {
+        band = -band;
+    }
+    if(band < policy->abs_deadband)
+    {
+        band = policy->abs_deadband;
+    }
+    return change > band;
+}
+
+// Decide whether value is reported now, fresh is 1 if a new sample arrived
+// since the last check. Return 1 if the caller should report, the state then
+// records value as reported.
+uint8_t check_report_policy(const BEACON_REPORT_POLICY_T *policy, BEACON_REPORT_STATE_T *state,
+                            float value, uint8_t fresh, time_t now)
+{
+    time_t since = now - state->last_time;
+
+    if(fresh)
+    {
+        state->pending = 1;
+    }
+
+    if(state->last_time == 0 && state->pending)
+    {
+        // first value is always reported
+    }
+    else if(policy->heartbeat && since >= (time_t)policy->heartbeat)
+    {
+        // repeat even without new samples
+    }
+    else if(!state->pending || since < (time_t)policy->min_period)
+    {
+        return 0;
+    }
+    else if(!report_policy_exceeds(policy, state, value) &&
+            !(policy->max_period && since >= (time_t)policy->max_period))
+    {
+        return 0;
+    }
+
+    state->last_value = value;
+    state->last_time  = now;
+    state->pending    = 0;
+    return 1;
+}
+
+// Earliest time a later check may report value without a new sample arriving,
+// 0 if no check can. value is the one last passed to check_report_policy(), it
+// only changes with new samples, so the caller can skip checks until then.
+time_t report_policy_due(const BEACON_REPORT_POLICY_T *policy, const BEACON_REPORT_STATE_T *state, float value)
+{
+    time_t due = 0;
+    time_t t = 0;
+
+    if(state->last_time == 0)
+    {
+        // the first report is due at once, any time in the past will do
+        return state->pending;
+    }
+    if(policy->heartbeat)
+    {
+        due = state->last_time + (time_t)policy->heartbeat;
+    }
+    if(state->pending && report_policy_exceeds(policy, state, value))
+    {
+        // held back by the minimum period only
+        t = state->last_time + (time_t)policy->min_period;
+    }
+    else if(state->pending && policy->max_period)
+    {
+        // held back by the deadband until the maximum period
+        t = state->last_time + (time_t)((policy->max_period > policy->min_period) ?
+                                        policy->max_period : policy->min_period);
+    }
+    if(t && (due == 0 || t < due))
+    {
+        due = t;
+    }
+    return due;
+}
@@ -0,0 +1,65 @@
+#ifndef BLE_REPORT_POLICY_H
+#define BLE_REPORT_POLICY_H
+
+#include <inttypes.h>
+#include <time.h>
+
+// change of a beacon value that is reported, in value units,
+// override with "beacon-report-deadband" in mbed_app.json
+#ifndef BEACON_REPORT_DEADBAND
+#define BEACON_REPORT_DEADBAND (0.1f)
+#endif
+
+// change relative to the last reported value that is reported, 0.05 = 5 %,
+// override with "beacon-report-relative-deadband" in mbed_app.json
+#ifndef BEACON_REPORT_REL_DEADBAND
+#define BEACON_REPORT_REL_DEADBAND (0.0f)
+#endif
+
+// RSSI change in dB and delivery ratio change in percentage points that are reported
+#ifndef BEACON_REPORT_RSSI_DEADBAND
+#define BEACON_REPORT_RSSI_DEADBAND (3.0f)
+#endif
+#ifndef BEACON_REPORT_DELIVERY_DEADBAND
+#define BEACON_REPORT_DELIVERY_DEADBAND (1.0f)
+#endif
+
+// seconds, override with "beacon-report-min-period", "beacon-report-max-period"
+// and "beacon-report-heartbeat" in mbed_app.json, 0 disables
+#ifndef BEACON_REPORT_MIN_PERIOD
+#define BEACON_REPORT_MIN_PERIOD (0)
+#endif
+#ifndef BEACON_REPORT_MAX_PERIOD
+#define BEACON_REPORT_MAX_PERIOD (300)
+#endif
+#ifndef BEACON_REPORT_HEARTBEAT
+#define BEACON_REPORT_HEARTBEAT (3600)
+#endif
+
+// Reporting policy of one resource. A new value is reported when it differs
+// from the last reported one by more than the larger of abs_deadband and
+// rel_deadband * |last|, but not sooner than min_period after the last report.
+// A value held back by the deadband still goes out once max_period has passed,
+// and with no new values at all the last one is repeated every heartbeat.
+typedef struct
+{
+    float abs_deadband;
+    float rel_deadband;
+    uint32_t min_period;
+    uint32_t max_period;
+    uint32_t heartbeat;
+} BEACON_REPORT_POLICY_T;
+
+// reporting state of one resource instance, all zero before the first report
+typedef struct
+{
+    float last_value;      // last reported value
+    time_t last_time;      // time of the last report, 0 if never reported
+    uint8_t pending;       // a newer value than last_value has not been reported
+} BEACON_REPORT_STATE_T;
+
+uint8_t check_report_policy(const BEACON_REPORT_POLICY_T *policy, BEACON_REPORT_STATE_T *state,
+                            float value, uint8_t fresh, time_t now);
+time_t report_policy_due(const BEACON_REPORT_POLICY_T *policy, const BEACON_REPORT_STATE_T *state, float value);
+
+#endif // BLE_REPORT_POLICY_H
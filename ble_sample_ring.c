@@ -0,0 +1,71 @@
+#include <string.h>
+#include "ble_sample_ring.h"
+
+#define RING_MASK            (BEACON_SAMPLE_RING_SIZE - 1u)
+
+#define RING_LOAD_RELAXED(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define RING_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define RING_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+static BEACON_SAMPLE_T sample_ring[BEACON_SAMPLE_RING_SIZE];
+
+// free running counters, written by producer (head) and consumer (tail) only
+static uint32_t ring_head;
+static uint32_t ring_tail;
+
+// samples dropped because the ring was full, written by producer only
+static uint32_t ring_drops;
+
+
+void init_sample_ring()
+{
+    memset(sample_ring, 0, sizeof(sample_ring));
+    ring_head  = 0;
+    ring_tail  = 0;
+    ring_drops = 0;
+}
+
+// queue sample, return 1 if ok, 0 if ring was full and sample was dropped
+uint8_t push_beacon_sample(const BEACON_SAMPLE_T *sample)
+{
+    uint32_t head = RING_LOAD_RELAXED(&ring_head);
+
+    if(head - RING_LOAD_ACQUIRE(&ring_tail) >= BEACON_SAMPLE_RING_SIZE)
+    {
+        RING_STORE_RELEASE(&ring_drops, RING_LOAD_RELAXED(&ring_drops) + 1u);
+        return 0;
+    }
+
+    sample_ring[head & RING_MASK] = *sample;
+    RING_STORE_RELEASE(&ring_head, head + 1u);
+
+    return 1;
+}
+
+// dequeue oldest sample, return 1 if ok, 0 if ring was empty
+uint8_t pop_beacon_sample(BEACON_SAMPLE_T *sample)
+{
+    uint32_t tail = RING_LOAD_RELAXED(&ring_tail);
+
+    if(tail == RING_LOAD_ACQUIRE(&ring_head))
+    {
+        return 0;
+    }
+
+    *sample = sample_ring[tail & RING_MASK];
+    RING_STORE_RELEASE(&ring_tail, tail + 1u);
+
+    return 1;
+}
+
+// number of samples that can be pushed without dropping, producer side
+uint32_t get_sample_ring_space()
+{
+    return BEACON_SAMPLE_RING_SIZE - (RING_LOAD_RELAXED(&ring_head) - RING_LOAD_ACQUIRE(&ring_tail));
+}
+
+// total number of dropped samples since init_sample_ring()
+uint32_t get_sample_ring_drops()
+{
+    return RING_LOAD_ACQUIRE(&ring_drops);
+}
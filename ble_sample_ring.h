@@ -0,0 +1,39 @@
+#ifndef BLE_SAMPLE_RING_H
+#define BLE_SAMPLE_RING_H
+
+#include <inttypes.h>
+#include "ble_beacon.h"
+
+// number of samples the ring can hold, must be a power of two,
+// override with "beacon-sample-ring-size" in mbed_app.json
+#ifndef BEACON_SAMPLE_RING_SIZE
+#define BEACON_SAMPLE_RING_SIZE (256)
+#endif
+
+#if (BEACON_SAMPLE_RING_SIZE & (BEACON_SAMPLE_RING_SIZE - 1)) != 0
+#error "BEACON_SAMPLE_RING_SIZE must be a power of two"
+#endif
+
+// one decoded advertisement, handed from the BLE scan callback to the publisher
+typedef struct
+{
+    uint8_t addr[BEACON_ADDR_LEN]; // advertiser address
+    uint8_t addr_type;             // advertiser address type
+    uint8_t id;                    // payload ID
+    uint8_t format;                // advertisement format, see ble_beacon_schema.h
+    int8_t rssi;                   // received signal strength in dBm
+    uint8_t seq_bits;              // width of the sequence counter, 0 if none
+    uint32_t seq;                  // rolling sequence counter from the payload
+    float value;                   // decoded value, e.g. temperature
+} BEACON_SAMPLE_T;
+
+// Single-producer/single-consumer ring. push_beacon_sample() may only be called
+// from one context (BLE events) and pop_beacon_sample() from one other context
+// (publisher), neither call blocks.
+void init_sample_ring();
+uint8_t push_beacon_sample(const BEACON_SAMPLE_T *sample);
+uint8_t pop_beacon_sample(BEACON_SAMPLE_T *sample);
+uint32_t get_sample_ring_drops();
+uint32_t get_sample_ring_space();
+
+#endif // BLE_SAMPLE_RING_H
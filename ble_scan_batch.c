@@ -0,0 +1,191 @@
+#include <string.h>
+#include "ble_scan_batch.h"
+#include "ble_adv_dedup.h"
+#include "ble_beacon_auth.h"
+#include "ble_beacon_schema.h"
+#include "ble_sample_ring.h"
+
+#define REPORT_MASK          (BEACON_REPORT_RING_SIZE - 1u)
+
+#define RING_LOAD_RELAXED(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define RING_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define RING_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+static BEACON_RAW_REPORT_T report_slab[BEACON_REPORT_RING_SIZE];
+
+// free running counters, written by producer (head) and consumer (tail) only
+static uint32_t report_head;
+static uint32_t report_tail;
+static uint32_t report_drops;
+
+// written by the consumer only
+static BEACON_BATCH_STATS_T batch_stats;
+static beacon_clock_us_t batch_clock_us;
+
+#if BEACON_AUTH
+// decoded reports held back until the batch has been verified
+static BEACON_AUTH_JOB_T auth_jobs[BEACON_BATCH_SIZE];
+static BEACON_SAMPLE_T auth_samples[BEACON_BATCH_SIZE];
+static uint32_t auth_pending;
+
+// verify the held back reports in one go and queue those that pass
+static void flush_auth_jobs(void)
+{
+    uint32_t n;
+
+    verify_beacon_auth_batch(auth_jobs, auth_pending);
+    for(n = 0; n < auth_pending; n++)
+    {
+        if(auth_jobs[n].ok)
+        {
+            push_beacon_sample(&auth_samples[n]);
+        }
+    }
+    auth_pending = 0;
+}
+#endif
+
+void init_scan_batch(beacon_clock_us_t clock_us)
+{
+    uint32_t n;
+
+    report_head    = 0;
+    report_tail    = 0;
+    report_drops   = 0;
+    batch_clock_us = clock_us;
+#if BEACON_AUTH
+    auth_pending   = 0;
+#endif
+    memset(&batch_stats, 0, sizeof(batch_stats));
+    for(n = 0; n < BEACON_PHY_COUNT; n++)
+    {
+        batch_stats.phy[n].rssi_min = 127;
+    }
+}
+
+// slot for the next report, NULL if the ring is full and the report is dropped
+BEACON_RAW_REPORT_T* reserve_scan_report()
+{
+    uint32_t head = RING_LOAD_RELAXED(&report_head);
+
+    if(head - RING_LOAD_ACQUIRE(&report_tail) >= BEACON_REPORT_RING_SIZE)
+    {
+        RING_STORE_RELEASE(&report_drops, RING_LOAD_RELAXED(&report_drops) + 1u);
+        return NULL;
+    }
+    return &report_slab[head & REPORT_MASK];
+}
+
+// publish the reserved report, return the number of reports waiting
+uint32_t commit_scan_report()
+{
+    uint32_t head = RING_LOAD_RELAXED(&report_head) + 1u;
+
+    RING_STORE_RELEASE(&report_head, head);
+    return head - RING_LOAD_ACQUIRE(&report_tail);
+}
+
+uint32_t get_scan_reports_pending()
+{
+    return RING_LOAD_ACQUIRE(&report_head) - RING_LOAD_ACQUIRE(&report_tail);
+}
+
+// decode up to max_reports reports, return number processed
+uint32_t process_scan_batch(uint32_t max_reports, uint32_t now_ms)
+{
+    uint32_t tail = RING_LOAD_RELAXED(&report_tail);
+    uint32_t avail = RING_LOAD_ACQUIRE(&report_head) - tail;
+    uint32_t start = batch_clock_us ? batch_clock_us() : 0;
+    uint32_t elapsed;
+    uint32_t n;
+    const BEACON_RAW_REPORT_T *r;
+    BEACON_PHY_STATS_T *phy;
+    BEACON_READING_T reading;
+    BEACON_SAMPLE_T sample;
+
+    if(avail > max_reports)
+    {
+        avail = max_reports;
+    }
+    if(avail == 0)
+    {
+        return 0;
+    }
+
+    for(n = 0; n < avail; n++)
+    {
+        r = &report_slab[(tail + n) & REPORT_MASK];
+        phy = &batch_stats.phy[(r->phy < BEACON_PHY_COUNT) ? r->phy : BEACON_PHY_1M];
+        phy->reports++;
+        phy->bytes += r->len;
+
+        // drop repeats before spending time on decoding
+        if(adv_is_duplicate(r->addr, r->data, r->len, now_ms) ||
+           !decode_beacon_adv(r->data, r->len, &reading))
+        {
+            continue;
+        }
+#if !BEACON_AUTH
+        // authenticated frames cannot be verified in this build
+        if(reading.format == BEACON_FMT_BEACON_TAG_AUTH)
+        {
+            continue;
+        }
+#endif
+        phy->decoded++;
+        phy->rssi_sum += r->rssi;
+        if(r->rssi < phy->rssi_min)
+        {
+            phy->rssi_min = r->rssi;
+        }
+
+        memcpy(sample.addr, r->addr, BEACON_ADDR_LEN);
+        sample.addr_type = r->addr_type;
+        sample.id        = reading.id;
+        sample.format    = reading.format;
+        sample.rssi      = r->rssi;
+        sample.seq_bits  = reading.seq_bits;
+        sample.seq       = reading.seq;
+        sample.value     = reading.value;
+        batch_stats.decoded++;
+#if BEACON_AUTH
+        // the report stays in its slot until the tail moves, verify it later
+        auth_jobs[auth_pending].report = r;
+        auth_jobs[auth_pending].format = reading.format;
+        auth_samples[auth_pending] = sample;
+        if(++auth_pending == BEACON_BATCH_SIZE)
+        {
+            flush_auth_jobs();
+        }
+#else
+        // registry is owned by the publisher, hand the sample over
+        push_beacon_sample(&sample);
+#endif
+    }
+#if BEACON_AUTH
+    if(auth_pending > 0)
+    {
+        flush_auth_jobs();
+    }
+#endif
+    RING_STORE_RELEASE(&report_tail, tail + avail);
+
+    elapsed = batch_clock_us ? (batch_clock_us() - start) : 0;
+    batch_stats.batches++;
+    batch_stats.reports  += avail;
+    batch_stats.last_us   = elapsed;
+    batch_stats.total_us += elapsed;
+    if(elapsed > batch_stats.max_us)
+    {
+        batch_stats.max_us = elapsed;
+    }
+
+    return avail;
+}
+
+// copy of the batch statistics, call from the consumer context
+void get_scan_batch_stats(BEACON_BATCH_STATS_T *stats)
+{
+    *stats = batch_stats;
+    stats->drops = RING_LOAD_ACQUIRE(&report_drops);
+}
@@ -0,0 +1,96 @@
+#ifndef BLE_SCAN_BATCH_H
+#define BLE_SCAN_BATCH_H
+
+#include <inttypes.h>
+#include "ble_beacon.h"
+
+// Scan for BLE 5 extended advertising on LE 1M and LE Coded PHY, enable with
+// "beacon-extended-scan" in mbed_app.json. Needs the extended scanning Gap API.
+#ifndef BEACON_EXTENDED_SCAN
+#define BEACON_EXTENDED_SCAN  (0)
+#endif
+
+// largest advertising payload kept per report: legacy advertising, or the
+// most one extended advertising report carries without fragmentation
+#if BEACON_EXTENDED_SCAN
+#define BEACON_ADV_DATA_MAX   (229)
+#else
+#define BEACON_ADV_DATA_MAX   (31)
+#endif
+
+// PHY a report was received on, see BEACON_BATCH_STATS_T
+#define BEACON_PHY_1M         (0)
+#define BEACON_PHY_2M         (1)
+#define BEACON_PHY_CODED      (2)
+#define BEACON_PHY_COUNT      (3)
+
+// raw reports buffered between the scan callback and the batch processor,
+// power of two, override with "beacon-report-ring-size" in mbed_app.json
+#ifndef BEACON_REPORT_RING_SIZE
+#define BEACON_REPORT_RING_SIZE (64)
+#endif
+
+#if (BEACON_REPORT_RING_SIZE & (BEACON_REPORT_RING_SIZE - 1)) != 0
+#error "BEACON_REPORT_RING_SIZE must be a power of two"
+#endif
+
+// reports decoded per batch processor wakeup,
+// override with "beacon-batch-size" in mbed_app.json
+#ifndef BEACON_BATCH_SIZE
+#define BEACON_BATCH_SIZE     (16)
+#endif
+
+// milliseconds a report may wait for its batch to fill,
+// override with "beacon-batch-max-latency-ms" in mbed_app.json
+#ifndef BEACON_BATCH_MAX_LATENCY_MS
+#define BEACON_BATCH_MAX_LATENCY_MS (50)
+#endif
+
+// one advertising report as delivered by the stack, undecoded
+typedef struct
+{
+    uint8_t addr[BEACON_ADDR_LEN];
+    uint8_t addr_type;
+    int8_t rssi;
+    uint8_t phy;           // BEACON_PHY_*, the data PHY for extended advertising
+    uint8_t len;
+    uint8_t data[BEACON_ADV_DATA_MAX];
+} BEACON_RAW_REPORT_T;
+
+// reach and throughput on one PHY
+typedef struct
+{
+    uint32_t reports;      // raw reports processed
+    uint32_t decoded;      // of those, decoded into beacon samples
+    uint32_t bytes;        // advertising payload bytes processed
+    int32_t rssi_sum;      // over decoded reports
+    int8_t rssi_min;       // weakest decoded report, 127 if none
+} BEACON_PHY_STATS_T;
+
+typedef struct
+{
+    uint32_t batches;      // batch processor runs with at least one report
+    uint32_t reports;      // raw reports processed
+    uint32_t decoded;      // reports decoded into beacon samples
+    uint32_t drops;        // reports dropped because the ring was full
+    uint32_t last_us;      // processing time of the last batch
+    uint32_t max_us;       // longest batch
+    uint64_t total_us;     // sum over all batches
+    BEACON_PHY_STATS_T phy[BEACON_PHY_COUNT];
+} BEACON_BATCH_STATS_T;
+
+// microsecond clock used to time batches
+typedef uint32_t (*beacon_clock_us_t)(void);
+
+// The scan callback reserves a slot, copies the report straight into it and
+// commits it. process_scan_batch() then drops duplicates, decodes and queues
+// samples for the publisher, up to max_reports per call. Single producer,
+// single consumer, as the sample ring.
+void init_scan_batch(beacon_clock_us_t clock_us);
+BEACON_RAW_REPORT_T* reserve_scan_report();
+uint32_t commit_scan_report();
+uint32_t get_scan_reports_pending();
+uint32_t process_scan_batch(uint32_t max_reports, uint32_t now_ms);
+void get_scan_batch_stats(BEACON_BATCH_STATS_T *stats);
+
+#endif // BLE_SCAN_BATCH_H
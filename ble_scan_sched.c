@@ -0,0 +1,121 @@
+#include "ble_scan_sched.h"
+
+// advertisements per beacon per second needed to meet the freshness deadline
+#define SCHED_REQUIRED_RATE  ((float)BEACON_SCHED_HITS_PER_DEADLINE / (float)BEACON_FRESHNESS_DEADLINE)
+// largest step down per cycle while everything is fresh
+#define SCHED_BACKOFF        (0.75f)
+
+
+// set interval/window for the duty cycle, return the duty cycle actually achieved
+static float sched_apply_duty(BEACON_SCAN_SCHED_T *sched, float duty)
+{
+    float window = duty * sched->base_interval_ms;
+    float interval = sched->base_interval_ms;
+
+    if(window < BEACON_SCAN_WINDOW_MIN_MS)
+    {
+        window = BEACON_SCAN_WINDOW_MIN_MS;
+        interval = window / duty;
+        if(interval > BEACON_SCAN_INTERVAL_MAX_MS)
+        {
+            interval = BEACON_SCAN_INTERVAL_MAX_MS;
+        }
+    }
+
+    sched->interval_ms = (uint16_t)(interval + 0.5f);
+    sched->window_ms   = (uint16_t)(window + 0.5f);
+    if(sched->window_ms > sched->interval_ms)
+    {
+        sched->window_ms = sched->interval_ms;
+    }
+    return (float)sched->window_ms / (float)sched->interval_ms;
+}
+
+void init_scan_sched(BEACON_SCAN_SCHED_T *sched, uint16_t interval_ms, uint16_t window_ms)
+{
+    sched->base_interval_ms = interval_ms;
+    sched->interval_ms      = interval_ms;
+    sched->window_ms        = window_ms;
+    sched->duty             = (float)window_ms / (float)interval_ms;
+    sched->min_duty         = (float)BEACON_SCAN_WINDOW_MIN_MS / (float)BEACON_SCAN_INTERVAL_MAX_MS;
+    sched->arrival_rate     = 0;
+    sched->coverage         = 1.0f;
+    sched->coverage_avg     = 1.0f;
+    sched->cycles           = 0;
+    sched->cycles_on_target = 0;
+}
+
+// feed one scan cycle, return 1 if interval or window changed and scanning
+// should be restarted with the new values
+uint8_t update_scan_sched(BEACON_SCAN_SCHED_T *sched, uint32_t arrivals, uint32_t fresh,
+                          uint32_t known, uint32_t elapsed_ms)
+{
+    uint16_t old_interval = sched->interval_ms;
+    uint16_t old_window = sched->window_ms;
+    float rate;
+    float want;
+    float duty;
+
+    // nothing to keep fresh, stay on the current schedule for discovery
+    if(known == 0 || elapsed_ms == 0)
+    {
+        sched->coverage = 1.0f;
+        return 0;
+    }
+
+    rate = ((float)arrivals * 1000.0f) / ((float)elapsed_ms * (float)known);
+    sched->arrival_rate = (sched->cycles == 0) ? rate : sched->arrival_rate + (rate - sched->arrival_rate) / 4.0f;
+
+    sched->coverage = (float)fresh / (float)known;
+    sched->coverage_avg += (sched->coverage - sched->coverage_avg) / 8.0f;
+    sched->cycles++;
+    if(sched->coverage * 100.0f >= BEACON_COVERAGE_TARGET)
+    {
+        sched->cycles_on_target++;
+    }
+
+    // duty cycle at which the arrival rate would just meet the deadline
+    want = (sched->arrival_rate > 0) ? (sched->duty * SCHED_REQUIRED_RATE / sched->arrival_rate)
+                                     : (sched->duty * 2.0f);
+
+    if(sched->coverage * 100.0f < BEACON_COVERAGE_TARGET)
+    {
+        // stale beacons: widen quickly
+        if(want < sched->duty * 2.0f)
+        {
+            want = sched->duty * 2.0f;
+        }
+    }
+    else if(fresh < known)
+    {
+        // on target but not everything fresh: do not back off
+        if(want < sched->duty)
+        {
+            want = sched->duty;
+        }
+    }
+    else if(want < sched->duty * SCHED_BACKOFF)
+    {
+        want = sched->duty * SCHED_BACKOFF;
+    }
+
+    if(want > 1.0f)
+    {
+        want = 1.0f;
+    }
+    if(want < sched->min_duty)
+    {
+        want = sched->min_duty;
+    }
+
+    duty = sched_apply_duty(sched, want);
+    if(sched->interval_ms == old_interval && sched->window_ms == old_window)
+    {
+        return 0;
+    }
+
+    // arrivals are assumed to scale with the time spent listening
+    sched->arrival_rate *= duty / sched->duty;
+    sched->duty = duty;
+    return 1;
+}
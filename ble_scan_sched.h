@@ -0,0 +1,57 @@
+#ifndef BLE_SCAN_SCHED_H
+#define BLE_SCAN_SCHED_H
+
+#include <inttypes.h>
+
+// seconds within which every beacon should be heard again,
+// override with "beacon-freshness-deadline" in mbed_app.json
+#ifndef BEACON_FRESHNESS_DEADLINE
+#define BEACON_FRESHNESS_DEADLINE (30)
+#endif
+
+// percentage of beacons that should be fresh,
+// override with "beacon-coverage-target" in mbed_app.json
+#ifndef BEACON_COVERAGE_TARGET
+#define BEACON_COVERAGE_TARGET (95)
+#endif
+
+// scan timing limits in milliseconds
+#ifndef BEACON_SCAN_WINDOW_MIN_MS
+#define BEACON_SCAN_WINDOW_MIN_MS (20)
+#endif
+#ifndef BEACON_SCAN_INTERVAL_MAX_MS
+#define BEACON_SCAN_INTERVAL_MAX_MS (2000)
+#endif
+
+// advertisements wanted from each beacon per freshness deadline,
+// the margin for reports lost to collisions and channel hopping
+#define BEACON_SCHED_HITS_PER_DEADLINE (3)
+
+// Scan duty-cycle scheduler. Once per scan cycle update_scan_sched() is given
+// the beacon advertisements decoded during the cycle and the registry's
+// freshness. The duty cycle needed to hear every beacon
+// BEACON_SCHED_HITS_PER_DEADLINE times per deadline is estimated from the
+// smoothed per-beacon arrival rate, assuming the rate scales with the duty
+// cycle. While coverage is below target the duty cycle at least doubles,
+// once every beacon is fresh it backs off towards the estimate.
+// The window is duty * base interval; below BEACON_SCAN_WINDOW_MIN_MS the
+// interval is stretched instead, up to BEACON_SCAN_INTERVAL_MAX_MS.
+typedef struct
+{
+    uint16_t base_interval_ms;
+    uint16_t interval_ms;     // current scan interval
+    uint16_t window_ms;       // current scan window
+    float duty;               // window / interval
+    float min_duty;
+    float arrival_rate;       // smoothed advertisements per beacon per second at the current duty
+    float coverage;           // fresh / known beacons at the last update, 1 if none known
+    float coverage_avg;       // smoothed coverage
+    uint32_t cycles;          // updates with known beacons
+    uint32_t cycles_on_target; // of those, updates with coverage at or above target
+} BEACON_SCAN_SCHED_T;
+
+void init_scan_sched(BEACON_SCAN_SCHED_T *sched, uint16_t interval_ms, uint16_t window_ms);
+uint8_t update_scan_sched(BEACON_SCAN_SCHED_T *sched, uint32_t arrivals, uint32_t fresh,
+                          uint32_t known, uint32_t elapsed_ms);
+
+#endif // BLE_SCAN_SCHED_H
@@ -0,0 +1,143 @@
+#include <string.h>
+#include "ble_senml.h"
+
+#define CBOR_UINT         (0x00u)
+#define CBOR_NINT         (0x20u)
+#define CBOR_TEXT         (0x60u)
+#define CBOR_ARRAY        (0x80u)
+#define CBOR_MAP          (0xA0u)
+#define CBOR_FLOAT32      (0xFAu)
+
+#define SENML_BT          (-3)
+#define SENML_N           (0)
+#define SENML_V           (2)
+#define SENML_T           (6)
+
+// records are written after room for the largest array header
+#define SENML_ARRAY_HEAD  (5u)
+
+// write CBOR head of major type with argument v, return bytes written
+static uint32_t cbor_head(uint8_t *p, uint8_t major, uint64_t v)
+{
+    uint32_t n;
+    uint32_t i;
+
+    if(v < 24u)
+    {
+        p[0] = (uint8_t)(major | v);
+        return 1;
+    }
+    if(v <= 0xFFu)
+    {
+        p[0] = major | 24u;
+        n = 1;
+    }
+    else if(v <= 0xFFFFu)
+    {
+        p[0] = major | 25u;
+        n = 2;
+    }
+    else if(v <= 0xFFFFFFFFu)
+    {
+        p[0] = major | 26u;
+        n = 4;
+    }
+    else
+    {
+        p[0] = major | 27u;
+        n = 8;
+    }
+    for(i = 0; i < n; i++)
+    {
+        p[n - i] = (uint8_t)(v >> (8 * i));
+    }
+    return n + 1;
+}
+
+static uint32_t cbor_int(uint8_t *p, int64_t v)
+{
+    return (v < 0) ? cbor_head(p, CBOR_NINT, (uint64_t)(-1 - v)) : cbor_head(p, CBOR_UINT, (uint64_t)v);
+}
+
+static uint32_t cbor_float(uint8_t *p, float v)
+{
+    uint32_t bits;
+
+    memcpy(&bits, &v, sizeof(bits));
+    p[0] = CBOR_FLOAT32;
+    p[1] = (uint8_t)(bits >> 24);
+    p[2] = (uint8_t)(bits >> 16);
+    p[3] = (uint8_t)(bits >> 8);
+    p[4] = (uint8_t)bits;
+    return 5;
+}
+
+// start an empty pack in buf, record times are encoded relative to base_time
+void senml_begin(BEACON_SENML_T *pack, uint8_t *buf, uint32_t buf_len, time_t base_time)
+{
+    pack->buf       = buf;
+    pack->buf_len   = buf_len;
+    pack->len       = 0;
+    pack->count     = 0;
+    pack->base_time = base_time;
+}
+
+// append one record, return 1 if ok, 0 if the name is too long or the record
+// does not fit (the pack is then unchanged)
+uint8_t senml_add_record(BEACON_SENML_T *pack, const char *name, time_t t, float value)
+{
+    uint8_t rec[BEACON_SENML_RECORD_MAX + 1 + 9];
+    uint32_t name_len = (uint32_t)strlen(name);
+    int64_t rel = (int64_t)t - (int64_t)pack->base_time;
+    uint32_t n;
+
+    if(name_len > BEACON_SENML_NAME_MAX)
+    {
+        return 0;
+    }
+
+    n = cbor_head(rec, CBOR_MAP, 2u + (pack->count == 0) + (rel != 0));
+    if(pack->count == 0)
+    {
+        n += cbor_int(&rec[n], SENML_BT);
+        n += cbor_int(&rec[n], (int64_t)pack->base_time);
+    }
+    n += cbor_int(&rec[n], SENML_N);
+    n += cbor_head(&rec[n], CBOR_TEXT, name_len);
+    memcpy(&rec[n], name, name_len);
+    n += name_len;
+    if(rel != 0)
+    {
+        n += cbor_int(&rec[n], SENML_T);
+        n += cbor_int(&rec[n], rel);
+    }
+    n += cbor_int(&rec[n], SENML_V);
+    n += cbor_float(&rec[n], value);
+
+    if(pack->buf_len < SENML_ARRAY_HEAD || pack->len + n > pack->buf_len - SENML_ARRAY_HEAD)
+    {
+        return 0;
+    }
+    memcpy(&pack->buf[SENML_ARRAY_HEAD + pack->len], rec, n);
+    pack->len += n;
+    pack->count++;
+    return 1;
+}
+
+// put the array header in front of the records and close the pack, return the
+// encoded length at the start of buf, 0 if the pack has no records
+uint32_t senml_finish(BEACON_SENML_T *pack)
+{
+    uint8_t head[SENML_ARRAY_HEAD];
+    uint32_t n;
+
+    if(pack->count == 0)
+    {
+        return 0;
+    }
+    n = cbor_head(head, CBOR_ARRAY, pack->count);
+    memmove(&pack->buf[n], &pack->buf[SENML_ARRAY_HEAD], pack->len);
+    memcpy(pack->buf, head, n);
+    pack->len += n;
+    return pack->len;
+}
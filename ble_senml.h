@@ -0,0 +1,37 @@
+#ifndef BLE_SENML_H
+#define BLE_SENML_H
+
+#include <inttypes.h>
+#include <time.h>
+
+// SenML-CBOR (RFC 8428) pack writer for the batched beacon report. The pack
+// is one CBOR array of records, each record a map of
+//   n (0): name, e.g. "beacon_03_temperature"
+//   t (6): time relative to the base time, omitted if 0
+//   v (2): value as float32
+// and the first record also carries the base time bt (-3) in seconds.
+#define BEACON_SENML_CONTENT_TYPE (112u)
+
+// longest record name, without the terminator
+#define BEACON_SENML_NAME_MAX     (31)
+
+// worst case encoded size of one record and of the array header plus base time,
+// a name of 24 characters or more needs a 2 byte text head
+#define BEACON_SENML_RECORD_MAX   (1 + (1 + 1 + (BEACON_SENML_NAME_MAX >= 24) + BEACON_SENML_NAME_MAX) + \
+                                   (1 + 9) + (1 + 5))
+#define BEACON_SENML_HEADER_MAX   (5 + (1 + 9))
+
+typedef struct
+{
+    uint8_t *buf;
+    uint32_t buf_len;
+    uint32_t len;          // bytes of records written so far
+    uint32_t count;        // records written so far
+    time_t base_time;
+} BEACON_SENML_T;
+
+void senml_begin(BEACON_SENML_T *pack, uint8_t *buf, uint32_t buf_len, time_t base_time);
+uint8_t senml_add_record(BEACON_SENML_T *pack, const char *name, time_t t, float value);
+uint32_t senml_finish(BEACON_SENML_T *pack);
+
+#endif // BLE_SENML_H
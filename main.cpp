@@ -1,10 +1,13 @@
 #include "simplem2mclient.h"
+#include <string.h>
 #ifdef TARGET_LIKE_MBED
 #include "mbed.h"
 #endif
 #include "application_init.h"
 #include "mcc_common_button_and_led.h"
 #include "blinky.h"
+#include "beacon_store.h"
+#include "scanner_backend.h"
 #ifndef MBED_CONF_MBED_CLOUD_CLIENT_DISABLE_CERTIFICATE_ENROLLMENT
 #include "certificate_enrollment_user_cb.h"
 #endif
@@ -13,42 +16,121 @@
 #define FEA_BLE 0
 /* Used to turn some debug prints on/off */
 #define DEBUG_PRINTS 0 
-#define BLE_BEACON_TAG_OFFSET 10
-#define BLE_BEACON_IDX_OFFSET 11
-#define BLE_BEACON_TEMP_OFFSET 12
+/* Milliseconds between draining the sample ring into the beacon table. A
+   replay at full speed (BEACON_REPLAY_SPEED 0) waits for room in the ring,
+   drain it continuously so the replay rate measures the ingest path. */
+#ifndef BEACON_INGEST_INTERVAL_MS
+#if defined(__linux__) && defined(BEACON_REPLAY_FILE) && defined(BEACON_REPLAY_SPEED) && (BEACON_REPLAY_SPEED == 0)
+#define BEACON_INGEST_INTERVAL_MS 1
+#else
+#define BEACON_INGEST_INTERVAL_MS 1000
+#endif
+#endif
+/* Milliseconds between updates sent to Pelion */
+#ifndef BEACON_PUBLISH_INTERVAL_MS
+#define BEACON_PUBLISH_INTERVAL_MS 10000
+#endif
+/* 1: publish all beacon updates of a cycle as one SenML-CBOR resource,
+   0: one resource per beacon value */
+#ifndef BEACON_BATCH_PUBLISH
+#define BEACON_BATCH_PUBLISH 1
+#endif
+/* Seconds between beacon registry checkpoints to storage */
+#ifndef BEACON_CHECKPOINT_INTERVAL
+#define BEACON_CHECKPOINT_INTERVAL 300
+#endif
 
 #if FEA_BLE
 #include <events/mbed_events.h>
 #include "ble/BLE.h"
 #endif
 
+/* Without BLE a Linux build can replay a recorded capture instead, define
+BEACON_REPLAY_FILE as its path, see ble_capture.h for the file format.
+Or it scans with a local adapter through a raw HCI socket, define
+BEACON_HCI_DEV as the adapter number (0 for hci0) */
+#if FEA_BLE
+#define BEACON_SCANNER 1
+#elif defined(__linux__) && defined(BEACON_REPLAY_FILE)
+#include <time.h>
+#include "replay_scanner.h"
+#define BEACON_SCANNER 1
+#elif defined(__linux__) && defined(BEACON_HCI_DEV)
+#include <time.h>
+#include "hci_scanner.h"
+#define BEACON_SCANNER 1
+#else
+#define BEACON_SCANNER 0
+#endif
+
 extern "C"
 {
+#include "ble_adv_dedup.h"
 #include "ble_beacon.h"
+#include "ble_beacon_auth.h"
+#include "ble_beacon_schema.h"
+#include "ble_report_policy.h"
+#include "ble_sample_ring.h"
+#include "ble_scan_batch.h"
+#include "ble_scan_sched.h"
+#include "ble_senml.h"
 }
 
+#if FEA_BLE && BEACON_EXTENDED_SCAN && (MBED_MAJOR_VERSION == 5) && (MBED_MINOR_VERSION < 11)
+#error "beacon-extended-scan needs the extended scanning Gap API of Mbed OS 5.11 or newer"
+#endif
+
+void ingest_beacon_samples();
+void on_beacon_evicted(uint32_t tbl_idx);
 void update_beacon_cloud_data();
 
 // value range 0-MAX_CONNECTED_BEACONS
-static uint8_t connected_beacons = 0;
+static uint32_t connected_beacons = 0;
 
-// bitmap indicating valid beacons
+// last validity bitmap sent to Pelion, see encode_beacon_validity()
 // bit 0 corresponds to beacon_data_res_tbl[0] and so on
-// note: must be under <= 63 bits in length
-static uint16_t data_valid_bmp = 0x0u;
+static uint8_t valid_bmp_payload[BEACON_BMP_MAX_ENCODED_LEN];
+static uint32_t valid_bmp_payload_len = 0;
+
+#if FEA_BLE
+/* Microsecond clock for scan batch timing */
+static uint32_t batch_clock_us(void)
+{
+    return us_ticker_read();
+}
+#elif BEACON_SCANNER
+static uint32_t batch_clock_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u);
+}
+#endif
 
 #if FEA_BLE
 
 static const uint8_t DEVICE_NAME[]        = "GAP_device";
 
-/* Duration of each mode in milliseconds */
-static const size_t MODE_DURATION_MS      = 6000;
+/* Scan filter policy is re-evaluated every cycle, in milliseconds */
+static const size_t SCAN_CYCLE_MS         = 6000;
 
 /* Time between each mode in milliseconds */
 static const size_t TIME_BETWEEN_MODES_MS = 5000;
 
 static const size_t CONNECTION_DURATION = 3000;
 
+/* Upper bound for the controller filter accept list, the controller may support fewer */
+#ifndef BEACON_ACCEPT_LIST_SIZE
+#define BEACON_ACCEPT_LIST_SIZE 32
+#endif
+
+
+/* Every Nth scan cycle ignores the accept list to discover new beacons */
+#ifndef BEACON_DISCOVERY_PERIOD
+#define BEACON_DISCOVERY_PERIOD 6
+#endif
+
 
 
 typedef struct {
@@ -66,7 +148,7 @@ typedef struct {
 
 static const ScanModeParam_t scanning_params = 
 /* interval      window    timeout       active */
-    { 500,       100,         5,         false };
+    { 500,       100,         0,         false };
 
 /* parameters to use when attempting to connect to maximise speed of connection */
 static const GapScanningParams connection_scan_params(
@@ -93,26 +175,41 @@ static const char* to_string(Gap::Phy_t phy) {
     }
 }
 
-class GAPDevice : private mbed::NonCopyable<GAPDevice>, public Gap::EventHandler
+class GAPDevice : private mbed::NonCopyable<GAPDevice>, public Gap::EventHandler, public ScannerBackend
 {
 public:
     GAPDevice() :
         _ble(BLE::Instance()),
         _led1(LED1, 0),
-        _set_index(0),
+        _scan_cycle(0),
         _is_in_scanning_mode(false),
-        _on_duration_end_id(0),
-        _scan_count(0) { };
+        _scan_cycle_id(0),
+        _scan_count(0),
+        _staged_count(0),
+        _staged_gen(0),
+        _filter_pending(0),
+        _accept_count(0),
+        _filtering(false),
+        _cycle_reports(0),
+        _fresh_beacons(0),
+        _known_beacons(0),
+        _batch_timer_id(0),
+        _coded_phy_supported(false) { };
 
     ~GAPDevice()
     {
+        if (_ble_thread.get_state() != rtos::Thread::Deleted) {
+            _event_queue.break_dispatch();
+            _ble_thread.join();
+        }
         if (_ble.hasInitialized()) {
             _ble.shutdown();
         }
     };
 
-    /** Start BLE interface initialisation */
-    void run()
+    /** Start BLE interface initialisation and the scan session, BLE events
+     *  are handled on their own thread so this returns at once */
+    virtual void run()
     {
         ble_error_t error;
 
@@ -145,8 +242,38 @@ public:
         /* to show we're running we'll blink every 500ms */
         _event_queue.call_every(500, this, &GAPDevice::blink);
 
-        /* this will not return until shutdown */
-        _event_queue.dispatch_forever();
+        /* scanning runs until the object is destroyed */
+        _ble_thread.start(mbed::callback(&_event_queue, &events::EventQueue::dispatch_forever));
+    };
+
+    /** Hand the current registry membership to the BLE thread for the
+     *  controller accept list. Called by the publisher, which owns the
+     *  registry. The staging buffer is not touched again until the BLE
+     *  thread has programmed it. */
+    virtual void stage_accept_list()
+    {
+        uint32_t gen = get_beacon_membership_gen();
+
+        if ((gen == _staged_gen) || __atomic_load_n(&_filter_pending, __ATOMIC_ACQUIRE)) {
+            return;
+        }
+
+        _staged_count = get_beacon_accept_list(_staged, BEACON_ACCEPT_LIST_SIZE);
+        _staged_gen = gen;
+        __atomic_store_n(&_filter_pending, 1, __ATOMIC_RELEASE);
+        _event_queue.call(this, &GAPDevice::apply_accept_list);
+    };
+
+    virtual const char *name() const
+    {
+        return "ble";
+    };
+
+    /** Hand the registry freshness to the scan scheduler, called by the publisher */
+    virtual void report_freshness(uint32_t fresh, uint32_t known)
+    {
+        __atomic_store_n(&_fresh_beacons, fresh, __ATOMIC_RELAXED);
+        __atomic_store_n(&_known_beacons, known, __ATOMIC_RELAXED);
     };
  
 
@@ -174,22 +301,36 @@ private:
             printf("INFO: GAP::setPreferedPhys failed with error code %s", BLE::errorToString(err));
         }
 
+        #if BEACON_EXTENDED_SCAN
+        if (!_ble.gap().isFeatureSupported(ble::controller_supported_features_t::LE_EXTENDED_ADVERTISING)) {
+            printf("INFO: controller does not support extended advertising, legacy PDUs only\r\n");
+        }
+        _coded_phy_supported = _ble.gap().isFeatureSupported(ble::controller_supported_features_t::LE_CODED_PHY);
+        if (!_coded_phy_supported) {
+            printf("INFO: controller does not support LE Coded PHY, scanning on LE 1M only\r\n");
+        }
+        #endif
+
         /* all calls are serialised on the user thread through the event queue */
-        _event_queue.call(this, &GAPDevice::demo_mode_start);
+        _event_queue.call(this, &GAPDevice::scan_session_start);
     };
 
-    /** queue up start of the current demo mode */
-    void demo_mode_start()
+    /** start the long-lived scan session */
+    void scan_session_start()
     {
-        _event_queue.call(this, &GAPDevice::scan);
+        _is_in_scanning_mode = true;
+        init_scan_sched(&_sched, scanning_params.interval, scanning_params.window);
 
-        /* for performance measurement keep track of duration of the demo mode */
-        _demo_duration.start();
-        /* keep track of our state */
+        /* a list staged before init completed is programmed now */
+        if (__atomic_load_n(&_filter_pending, __ATOMIC_ACQUIRE)) {
+            _event_queue.call(this, &GAPDevice::apply_accept_list);
+        } else {
+            _event_queue.call(this, &GAPDevice::scan);
+        }
 
-        /* queue up next demo mode */
-        _on_duration_end_id = _event_queue.call_in(
-            MODE_DURATION_MS, this, &GAPDevice::on_duration_end
+        /* periodically switch between filtered and discovery scanning */
+        _scan_cycle_id = _event_queue.call_every(
+            SCAN_CYCLE_MS, this, &GAPDevice::on_scan_cycle
         );
 
         printf("\r\n");
@@ -201,20 +342,53 @@ private:
         ble_error_t error;
 
         /* scanning happens repeatedly, interval is the number of milliseconds
-         * between each cycle of scanning */
-        uint16_t interval = scanning_params.interval;
+         * between each cycle of scanning, adjusted by the scan scheduler */
+        uint16_t interval = _sched.interval_ms;
 
         /* number of milliseconds we scan for each time we enter
          * the scanning cycle after the interval set above */
-        uint16_t window = scanning_params.window;
+        uint16_t window = _sched.window_ms;
 
-        /* how long to repeat the cycles of scanning in seconds */
+        /* how long to repeat the cycles of scanning in seconds, 0 scans
+         * until stopped */
         uint16_t timeout = scanning_params.timeout;
 
         /* active scanning will send a scan request to any scanable devices that
          * we see advertising */
         bool active = scanning_params.active;
 
+        #if BEACON_EXTENDED_SCAN
+        /* let the controller drop advertisements from unknown devices */
+        select_scan_policy();
+
+        /* legacy and extended advertising PDUs on LE 1M, and on LE Coded
+         * for long range tags when the controller supports it */
+        ble::ScanParameters params(
+            ble::phy_t::LE_1M,
+            ble::scan_interval_t(ble::millisecond_t(interval)),
+            ble::scan_window_t(ble::millisecond_t(window)),
+            active
+        );
+        params.set_filter(_filtering ? ble::scanning_filter_policy_t::FILTER_ADVERTISING
+                                     : ble::scanning_filter_policy_t::NO_FILTER);
+        if (_coded_phy_supported) {
+            params.set_coded_phy_configuration(
+                ble::scan_interval_t(ble::millisecond_t(interval)),
+                ble::scan_window_t(ble::millisecond_t(window)),
+                active
+            );
+        }
+
+        error = _ble.gap().setScanParameters(params);
+
+        if (error) {
+            printf("Error during Gap::setScanParameters\r\n");
+            return;
+        }
+
+        /* reports arrive through onAdvertisingReport() */
+        error = _ble.gap().startScan(ble::scan_duration_t::forever());
+        #else
         /* set the scanning parameters according to currently selected set */
         error = _ble.gap().setScanParams(interval, window, timeout, active);
 
@@ -223,9 +397,13 @@ private:
             return;
         }
 
+        /* let the controller drop advertisements from unknown devices */
+        select_scan_policy();
+
         /* start scanning and attach a callback that will handle advertisements
          * and scan requests responses */
         error = _ble.gap().startScan(this, &GAPDevice::on_scan);
+        #endif
 
         if (error) {
             printf("Error during Gap::startScan\r\n");
@@ -238,56 +416,206 @@ private:
     };
     
 
-    /** After a set duration this cycles to the next demo mode
-     *  unless a connection happened first */
-    void on_duration_end()
+    /** Program the accept list staged by the publisher into the controller.
+     *  The list cannot change while a scan uses it, so scanning is restarted. */
+    void apply_accept_list()
     {
-        /* alloted time has elapsed, move to next demo mode */
-        _event_queue.call(this, &GAPDevice::demo_mode_end);
+        static BLEProtocol::Address_t addresses[BEACON_ACCEPT_LIST_SIZE];
+        Gap::Whitelist_t whitelist;
+        uint32_t capacity = _ble.gap().getMaxWhitelistSize();
+        uint32_t i;
+        ble_error_t error;
+
+        /* keep the list staged until the scan session has started */
+        if (!_is_in_scanning_mode) {
+            return;
+        }
+
+        _ble.gap().stopScan();
+
+        /* empty, or more beacons than the controller can hold: no filtering */
+        _accept_count = 0;
+        if ((_staged_count != INVALID_U32) && (_staged_count > 0) && (_staged_count <= capacity)) {
+            for (i = 0; i < _staged_count; i++) {
+                addresses[i] = BLEProtocol::Address_t(
+                    (BLEProtocol::AddressType_t)_staged[i].addr_type, _staged[i].addr
+                );
+            }
+            whitelist.addresses = addresses;
+            whitelist.size = _staged_count;
+            whitelist.capacity = capacity;
+
+            error = _ble.gap().setWhitelist(whitelist);
+            if (error) {
+                printf("Error during Gap::setWhitelist: %s\r\n", BLE::errorToString(error));
+            } else {
+                _accept_count = _staged_count;
+            }
+        }
+        __atomic_store_n(&_filter_pending, 0, __ATOMIC_RELEASE);
+
+        scan();
+    };
+
+    /** Select the scan filter policy. Every BEACON_DISCOVERY_PERIOD cycles,
+     *  and whenever no accept list is programmed, the scan runs unfiltered so
+     *  that new beacons can still be found. */
+    void select_scan_policy()
+    {
+        bool discovery = ((_scan_cycle % BEACON_DISCOVERY_PERIOD) == 0) || (_accept_count == 0);
+
+        #if !BEACON_EXTENDED_SCAN
+        /* extended scanning passes the policy in its scan parameters */
+        ble_error_t error = _ble.gap().setScanningPolicyMode(
+            discovery ? Gap::SCAN_POLICY_IGNORE_WHITELIST : Gap::SCAN_POLICY_FILTER_ALL_ADV
+        );
+        if (error) {
+            printf("Error during Gap::setScanningPolicyMode\r\n");
+            discovery = true;
+        }
+        #endif
+        _filtering = !discovery;
+        #if DEBUG_PRINTS
+        printf("Scan filter: %s, %lu known beacons\r\n", discovery ? "off" : "accept list", _accept_count);
+        #endif
+    };
+
+    /** Adjust the duty cycle to the last cycle's arrivals and restart
+     *  scanning if the schedule or the filter policy changes */
+    void on_scan_cycle()
+    {
+        bool discovery;
+        bool restart;
+        BEACON_BATCH_STATS_T batch;
+        uint32_t arrivals;
+
+        get_scan_batch_stats(&batch);
+        arrivals = batch.decoded - _cycle_reports;
+        _cycle_reports = batch.decoded;
+        restart = update_scan_sched(&_sched, arrivals,
+                                    __atomic_load_n(&_fresh_beacons, __ATOMIC_RELAXED),
+                                    __atomic_load_n(&_known_beacons, __ATOMIC_RELAXED),
+                                    SCAN_CYCLE_MS);
+        if (_sched.cycles > 0) {
+            printf("Scan coverage %d%% (avg %d%%, target %d%%, %lu/%lu cycles on target), interval %dms window %dms\r\n",
+                   (int)(_sched.coverage * 100), (int)(_sched.coverage_avg * 100), BEACON_COVERAGE_TARGET,
+                   _sched.cycles_on_target, _sched.cycles, _sched.interval_ms, _sched.window_ms);
+        }
+        if (batch.batches > 0) {
+            printf("Scan batches: %lu, %lu reports, last %lu us, max %lu us, avg %lu us, %lu dropped\r\n",
+                   batch.batches, batch.reports, batch.last_us, batch.max_us,
+                   (uint32_t)(batch.total_us / batch.batches), batch.drops);
+        }
+        for (uint32_t p = 0; p < BEACON_PHY_COUNT; p++) {
+            static const char *phy_names[BEACON_PHY_COUNT] = { "LE 1M", "LE 2M", "LE coded" };
+            const BEACON_PHY_STATS_T *phy = &batch.phy[p];
+
+            if (phy->decoded > 0) {
+                printf("  %s: %lu reports, %lu beacon, %lu bytes, RSSI avg %ld min %d dBm\r\n",
+                       phy_names[p], phy->reports, phy->decoded, phy->bytes,
+                       phy->rssi_sum / (int32_t)phy->decoded, phy->rssi_min);
+            }
+        }
+
+        _scan_cycle++;
+        discovery = ((_scan_cycle % BEACON_DISCOVERY_PERIOD) == 0) || (_accept_count == 0);
+        if (restart || (discovery == _filtering)) {
+            _ble.gap().stopScan();
+            scan();
+        }
     };
 
-    /** Parse scan payload */
+    /** Copy the scan report for the batch processor, decoding happens there */
     void on_scan(const Gap::AdvertisementCallbackParams_t *params)
     {
-        /* Tag */
-        uint8_t beacon_tag;
-        /* Beacon index */
-        uint8_t beacon_idx;
-        /* Temperature value */
-        uint8_t beacon_temp;
+        queue_report(params->peerAddr, (uint8_t)params->addressType, params->rssi, BEACON_PHY_1M,
+                     params->advertisingData, params->advertisingDataLen);
+    };
+
+    #if BEACON_EXTENDED_SCAN
+    /**
+     * Implementation of Gap::EventHandler::onAdvertisingReport, used by
+     * extended scanning for both legacy and extended advertising
+     */
+    virtual void onAdvertisingReport(const ble::AdvertisingReportEvent &event)
+    {
+        uint8_t phy = BEACON_PHY_1M;
+
+        /* chained extended advertising data is not reassembled */
+        if (event.getType().more_data_to_come() || event.getType().truncated()) {
+            _scan_count++;
+            return;
+        }
+
+        /* the data of an extended advertisement travels on the secondary PHY,
+           which may differ from the primary one (e.g. 1M primary, Coded secondary) */
+        if (event.getSecondaryPhy() == ble::phy_t::LE_CODED) {
+            phy = BEACON_PHY_CODED;
+        } else if (event.getSecondaryPhy() == ble::phy_t::LE_2M) {
+            phy = BEACON_PHY_2M;
+        } else if (event.getPrimaryPhy() == ble::phy_t::LE_CODED) {
+            phy = BEACON_PHY_CODED;
+        }
+
+        queue_report(event.getPeerAddress().data(), (uint8_t)event.getPeerAddressType().value(),
+                     event.getRssi(), phy, event.getPayload().data(), event.getPayload().size());
+    };
+    #endif
+
+    /** Copy one advertising report into the report ring and wake the batch processor */
+    void queue_report(const uint8_t *addr, uint8_t addr_type, int8_t rssi, uint8_t phy,
+                      const uint8_t *data, uint32_t len)
+    {
+        BEACON_RAW_REPORT_T *report;
+        uint32_t pending;
         /* keep track of scan events for performance reporting */
         _scan_count++;
 
         #if DEBUG_PRINTS
-        for (uint8_t i = 0; i < params->advertisingDataLen; ++i) {
-            printf("%02x ", params->advertisingData[i]);
+        for (uint32_t i = 0; i < len; ++i) {
+            printf("%02x ", data[i]);
         }
         printf("\r\n");
         #endif
 
-        if (params->advertisingDataLen > BLE_BEACON_TEMP_OFFSET + 1)
-        {
-            beacon_tag = params->advertisingData[BLE_BEACON_TAG_OFFSET];
-            /* Check that beacon has our tag */
-            if (0xAF == beacon_tag)
-            {
-                beacon_idx = params->advertisingData[BLE_BEACON_IDX_OFFSET];
-                beacon_temp = params->advertisingData[BLE_BEACON_TEMP_OFFSET];
-                #if DEBUG_PRINTS
-                printf("Beacon index = %d, Beacon temp = %d\n", beacon_idx, beacon_temp);
-                #endif
-                if (1 /* BLE device connected */ && (connected_beacons < MAX_CONNECTED_BEACONS))
-                {
-                    uint32_t result = add_beacon(beacon_idx);
-
-                    if (result != INVALID_U32)
-                    {
-                        data_valid_bmp |= (0x1u << beacon_idx);
-                        connected_beacons++;
-                    }
-                } 
-                update_beacon_data(beacon_idx, beacon_temp);
-            }
+        report = reserve_scan_report();
+        if (report == NULL) {
+            return;
+        }
+        memcpy(report->addr, addr, BEACON_ADDR_LEN);
+        report->addr_type = addr_type;
+        report->rssi = rssi;
+        report->phy = phy;
+        report->len = (len < BEACON_ADV_DATA_MAX) ? len : BEACON_ADV_DATA_MAX;
+        memcpy(report->data, data, report->len);
+        pending = commit_scan_report();
+
+        /* wake the batch processor on a full batch, or after the latency
+         * limit for the first report of a batch */
+        if ((pending % BEACON_BATCH_SIZE) == 0) {
+            _event_queue.call(this, &GAPDevice::process_batch);
+        } else if ((pending == 1) && (_batch_timer_id == 0)) {
+            _batch_timer_id = _event_queue.call_in(
+                BEACON_BATCH_MAX_LATENCY_MS, this, &GAPDevice::process_batch
+            );
+        }
+    };
+
+    /** Decode one batch of scan reports and hand the samples to the publisher */
+    void process_batch()
+    {
+        if (_batch_timer_id) {
+            _event_queue.cancel(_batch_timer_id);
+            _batch_timer_id = 0;
+        }
+
+        process_scan_batch(BEACON_BATCH_SIZE, (uint32_t)rtos::Kernel::get_ms_count());
+
+        /* leftovers of a partial batch wait at most the latency limit */
+        if (get_scan_reports_pending() > 0) {
+            _batch_timer_id = _event_queue.call_in(
+                BEACON_BATCH_MAX_LATENCY_MS, this, &GAPDevice::process_batch
+            );
         }
     };
 
@@ -345,18 +673,17 @@ private:
      *  or connection initiation */
     void on_timeout(const Gap::TimeoutSource_t source)
     {
-        _demo_duration.stop();
-
         switch (source) {
             case Gap::TIMEOUT_SRC_ADVERTISING:
                 printf("Stopped advertising early due to timeout parameter\r\n");
                 break;
             case Gap::TIMEOUT_SRC_SCAN:
+                /* keep the session alive */
                 printf("Stopped scanning early due to timeout parameter\r\n");
+                _event_queue.call(this, &GAPDevice::scan);
                 break;
             case Gap::TIMEOUT_SRC_CONN:
                 printf("Failed to connect after scanning %d advertisements\r\n", _scan_count);
-                _event_queue.call(this, &GAPDevice::demo_mode_end);
                 break;
             default:
                 printf("Unexpected timeout\r\n");
@@ -364,21 +691,6 @@ private:
         }
     };
 
-    /** clean up after last run, cycle to the next mode and launch it */
-    void demo_mode_end()
-    {
-        /* reset the demo ready for the next mode */
-        _scan_count = 0;
-        _demo_duration.stop();
-        _demo_duration.reset();
-
-        /* cycle through all demo modes */
-        _set_index++;
-
-        _ble.shutdown();
-        _event_queue.break_dispatch();
-    };
-
     /** Schedule processing of events from the BLE middleware in the event queue. */
     void schedule_ble_events(BLE::OnEventsToProcessCallbackContext *context)
     {
@@ -394,18 +706,40 @@ private:
 private:
     BLE                &_ble;
     events::EventQueue  _event_queue;
+    rtos::Thread        _ble_thread;
     DigitalOut          _led1;
 
-    /* Keep track of our progress through demo modes */
-    size_t              _set_index;
+    /* Keep track of our progress through scan cycles */
+    size_t              _scan_cycle;
     bool                _is_in_scanning_mode;
-    /* Remember the call id of the function on _event_queue
-     * so we can cancel it if we need to end the mode early */
-    int                 _on_duration_end_id;
+    /* Remember the call id of the periodic scan cycle on _event_queue */
+    int                 _scan_cycle_id;
 
-    /* Measure performance of our advertising/scanning */
-    Timer               _demo_duration;
+    /* Measure performance of our scanning */
     size_t              _scan_count;
+
+    /* accept list handed over by the publisher, see stage_accept_list() */
+    BEACON_ACCEPT_ENTRY_T _staged[BEACON_ACCEPT_LIST_SIZE];
+    uint32_t            _staged_count;
+    uint32_t            _staged_gen;
+    uint8_t             _filter_pending;
+
+    /* addresses in the controller accept list, 0 if none programmed */
+    uint32_t            _accept_count;
+    /* current scan uses the accept list */
+    bool                _filtering;
+
+    /* scan duty-cycle scheduler and its inputs */
+    BEACON_SCAN_SCHED_T _sched;
+    uint32_t            _cycle_reports;
+    uint32_t            _fresh_beacons;
+    uint32_t            _known_beacons;
+
+    /* call id of the pending batch latency timeout, 0 if none */
+    int                 _batch_timer_id;
+
+    /* controller can scan on LE Coded PHY, see BEACON_EXTENDED_SCAN */
+    bool                _coded_phy_supported;
 };
 #endif /* FEA_BLE */
 
@@ -419,7 +753,56 @@ int main(void)
 }
 
 // Pointers to the resources that will be created in main_application().
-static M2MResource* beacon_data_res_tbl[MAX_CONNECTED_BEACONS];
+// Formats publishing on the same object/resource share the pointer.
+static M2MResource* beacon_data_res_tbl[MAX_CONNECTED_BEACONS][BEACON_FMT_COUNT];
+// Vendor object for the per-beacon link statistics, one instance per beacon.
+// Object 4 describes the gateway's own link and has a single instance.
+#define BEACON_LINK_OBJECT 33001
+#define BEACON_LINK_RES_COUNT 5
+#define BEACON_LINK_RES_DELIVERY 5
+#define BEACON_LINK_RES_RSSI 6
+static const char* const beacon_link_res_names[BEACON_LINK_RES_COUNT] =
+    { "received", "lost", "dups", "reorders", "resyncs" };
+// Smoothed RSSI per beacon in dBm (BEACON_LINK_OBJECT/<beacon>/6)
+static M2MResource* beacon_rssi_res_tbl[MAX_CONNECTED_BEACONS];
+// Delivery ratio in percent from the payload sequence counter (BEACON_LINK_OBJECT/<beacon>/5)
+static M2MResource* beacon_delivery_res_tbl[MAX_CONNECTED_BEACONS];
+// Sequence counters per beacon (BEACON_LINK_OBJECT/<beacon>/0..4)
+static M2MResource* beacon_link_res_tbl[MAX_CONNECTED_BEACONS][BEACON_LINK_RES_COUNT];
+// Reporting policy per published beacon value, see ble_report_policy.h
+enum { BEACON_REPORT_VALUE, BEACON_REPORT_RSSI, BEACON_REPORT_DELIVERY, BEACON_REPORT_KINDS };
+// name suffix per kind, the value is named after its schema resource
+static const char* const beacon_report_names[BEACON_REPORT_KINDS] = { NULL, "rssi", "delivery" };
+static const BEACON_REPORT_POLICY_T beacon_report_policy[BEACON_REPORT_KINDS] =
+{
+    { BEACON_REPORT_DEADBAND, BEACON_REPORT_REL_DEADBAND,
+      BEACON_REPORT_MIN_PERIOD, BEACON_REPORT_MAX_PERIOD, BEACON_REPORT_HEARTBEAT },
+    { BEACON_REPORT_RSSI_DEADBAND, 0.0f,
+      BEACON_REPORT_MIN_PERIOD, BEACON_REPORT_MAX_PERIOD, BEACON_REPORT_HEARTBEAT },
+    { BEACON_REPORT_DELIVERY_DEADBAND, 0.0f,
+      BEACON_REPORT_MIN_PERIOD, BEACON_REPORT_MAX_PERIOD, BEACON_REPORT_HEARTBEAT },
+};
+static BEACON_REPORT_STATE_T beacon_report_state[MAX_CONNECTED_BEACONS][BEACON_REPORT_KINDS];
+// Beacons with a report due without new samples, one bucket per publish cycle,
+// bit i <-> beacon i. Due times past the last bucket are parked there and
+// rescheduled when it comes round, so idle beacons cost nothing most cycles.
+#define BEACON_REPORT_WHEEL_SIZE 64
+#define BEACON_REPORT_CYCLE_S ((BEACON_PUBLISH_INTERVAL_MS + 999) / 1000)
+static uint32_t beacon_report_wheel[BEACON_REPORT_WHEEL_SIZE][BEACON_BMP_WORDS];
+static uint32_t beacon_report_cycle;
+#if BEACON_BATCH_PUBLISH
+// SenML-CBOR pack of all beacons updated in a publish cycle (BEACON_BATCH_OBJECT/0/0),
+// value, RSSI and delivery ratio records per beacon
+#define BEACON_BATCH_OBJECT 33000
+#define BEACON_BATCH_RECORDS BEACON_REPORT_KINDS
+// per-beacon resources stay readable but only the batch is observed
+#define BEACON_RES_OBSERVABLE false
+static M2MResource* beacon_batch_res;
+static uint8_t beacon_batch_payload[BEACON_SENML_HEADER_MAX +
+                                    MAX_CONNECTED_BEACONS * BEACON_BATCH_RECORDS * BEACON_SENML_RECORD_MAX];
+#else
+#define BEACON_RES_OBSERVABLE true
+#endif
 static M2MResource* pelion_data_valid_bmp;
 
 
@@ -446,31 +829,245 @@ void factory_reset(void *)
     }
 }
 
+// applies samples queued by the BLE scan callback to the beacon table
+void ingest_beacon_samples()
+{
+    BEACON_SAMPLE_T sample;
+    uint32_t tbl_idx;
+
+    while (pop_beacon_sample(&sample))
+    {
+        tbl_idx = find_beacon(sample.addr, sample.id);
+
+        if ((tbl_idx == INVALID_U32) && (connected_beacons < MAX_CONNECTED_BEACONS))
+        {
+            tbl_idx = add_beacon(sample.addr, sample.id);
+
+            if (tbl_idx != INVALID_U32)
+            {
+                set_beacon_source(tbl_idx, sample.addr_type, sample.format);
+                connected_beacons++;
+            }
+        }
+        if (tbl_idx != INVALID_U32)
+        {
+            update_beacon_data(tbl_idx, sample.value);
+            update_beacon_rssi(tbl_idx, sample.rssi);
+            if (sample.seq_bits)
+            {
+                update_beacon_seq(tbl_idx, sample.seq, sample.seq_bits);
+            }
+        }
+    }
+}
+
+// called by expire_stale_beacons() for each beacon silent for too long
+void on_beacon_evicted(uint32_t tbl_idx)
+{
+    uint32_t b;
+
+    printf("Beacon %lu silent for %d s, evicting\n", tbl_idx, BEACON_SILENCE_TIMEOUT);
+    connected_beacons--;
+    /* the slot's next beacon starts with a first report */
+    memset(beacon_report_state[tbl_idx], 0, sizeof(beacon_report_state[tbl_idx]));
+    for (b = 0; b < BEACON_REPORT_WHEEL_SIZE; b++)
+    {
+        beacon_report_wheel[b][tbl_idx >> 5] &= ~(0x1u << (tbl_idx & 31u));
+    }
+}
+
+// check beacon i again in the first publish cycle at or after due, 0 if never
+static void schedule_beacon_report(uint32_t i, time_t due, time_t now)
+{
+    time_t ahead;
+
+    if (due == 0)
+    {
+        return;
+    }
+    ahead = (due - now + BEACON_REPORT_CYCLE_S - 1) / BEACON_REPORT_CYCLE_S;
+    if (ahead < 1)
+    {
+        ahead = 1;
+    }
+    else if (ahead > BEACON_REPORT_WHEEL_SIZE - 1)
+    {
+        ahead = BEACON_REPORT_WHEEL_SIZE - 1;
+    }
+    beacon_report_wheel[(beacon_report_cycle + (uint32_t)ahead) % BEACON_REPORT_WHEEL_SIZE][i >> 5] |=
+        0x1u << (i & 31u);
+}
+
+#if BEACON_BATCH_PUBLISH
+// append a record for each value of one beacon selected in report (bit per
+// BEACON_REPORT_*) to the batch, return 0 if some did not fit
+static uint8_t add_beacon_batch_records(BEACON_SENML_T *pack, uint32_t i, const BEACON_SNAPSHOT_T *beacon,
+                                        const float *values, uint8_t report)
+{
+    char name[BEACON_SENML_NAME_MAX + 1];
+    uint8_t ok = 1;
+    uint8_t k;
+
+    for (k = 0; k < BEACON_REPORT_KINDS; k++)
+    {
+        if (report & (0x1u << k))
+        {
+            snprintf(name, sizeof(name), "beacon_%02x_%s", (unsigned)i,
+                     beacon_report_names[k] ? beacon_report_names[k] : get_beacon_schema(beacon->info.format)->res_name);
+            ok &= senml_add_record(pack, name, beacon->update_time, values[k]);
+        }
+    }
+    return ok;
+}
+#endif
+
 // sets new values for resources in Pelion based on client-side data
 void update_beacon_cloud_data()
 {
     uint32_t i = 0;
+    uint32_t w = 0;
+    uint32_t dirty = 0;
+    uint32_t visit = 0;
     uint32_t updated_count = 0;
+    uint32_t drops = get_sample_ring_drops();
+    static uint32_t reported_drops = 0;
+    time_t now = time(NULL);
+    BEACON_SNAPSHOT_T beacon;
+    float values[BEACON_REPORT_KINDS];
+    uint32_t *due_now = beacon_report_wheel[beacon_report_cycle % BEACON_REPORT_WHEEL_SIZE];
+    time_t due;
+    time_t t;
+    uint8_t report;
+    uint8_t k;
+#if BEACON_BATCH_PUBLISH
+    BEACON_SENML_T pack;
+    uint32_t pack_len;
+
+    senml_begin(&pack, beacon_batch_payload, sizeof(beacon_batch_payload), now);
+#endif
 
-    BEACON_DATA_T* data_tbl = get_beacon_tbl();
-    BEACON_DATA_T* beacon;
-
-    for (i = 0; i < MAX_CONNECTED_BEACONS; i++)
+    /* visit only beacons updated since the last cycle or with a report due by the policy */
+    for (w = 0; w < BEACON_BMP_WORDS; w++)
     {
-        beacon = &(data_tbl[i]);
+        dirty = take_dirty_beacons(w);
+        visit = dirty | due_now[w];
+        due_now[w] = 0;
 
-        if (beacon->element_used && beacon->updated)
+        while (visit)
         {
-            beacon_data_res_tbl[i]->set_value_float(beacon->temp);
-            beacon->updated = 0;
-            printf("Beacon %lu temperature updated: %f C\n", i, beacon->temp);
+            i = (w << 5) + beacon_ctz32(visit);
+            visit &= visit - 1;
+
+            if (!read_beacon_snapshot(i, &beacon) || (beacon.info.format >= BEACON_FMT_COUNT))
+            {
+                continue;
+            }
+
+            values[BEACON_REPORT_VALUE]    = beacon.temp;
+            values[BEACON_REPORT_RSSI]     = beacon.rssi;
+            values[BEACON_REPORT_DELIVERY] = get_beacon_delivery_ratio(&beacon.link);
+            report = 0;
+            due = 0;
+            for (k = 0; k < BEACON_REPORT_KINDS; k++)
+            {
+                if ((k == BEACON_REPORT_DELIVERY) && !beacon.link.seq_bits)
+                {
+                    continue;
+                }
+                if (check_report_policy(&beacon_report_policy[k], &beacon_report_state[i][k], values[k],
+                                        (dirty >> (i & 31u)) & 0x1u, now))
+                {
+                    report |= (uint8_t)(0x1u << k);
+                }
+                t = report_policy_due(&beacon_report_policy[k], &beacon_report_state[i][k], values[k]);
+                if (t && (due == 0 || t < due))
+                {
+                    due = t;
+                }
+            }
+            schedule_beacon_report(i, due, now);
+            if (!report)
+            {
+                continue;
+            }
+
+            if (report & (0x1u << BEACON_REPORT_VALUE))
+            {
+                beacon_data_res_tbl[i][beacon.info.format]->set_value_float(beacon.temp);
+            }
+            if (report & (0x1u << BEACON_REPORT_RSSI))
+            {
+                beacon_rssi_res_tbl[i]->set_value_float(beacon.rssi);
+            }
+            if (report & (0x1u << BEACON_REPORT_DELIVERY))
+            {
+                beacon_delivery_res_tbl[i]->set_value_float(values[BEACON_REPORT_DELIVERY]);
+                beacon_link_res_tbl[i][0]->set_value(beacon.link.received);
+                beacon_link_res_tbl[i][1]->set_value(beacon.link.lost);
+                beacon_link_res_tbl[i][2]->set_value(beacon.link.dups);
+                beacon_link_res_tbl[i][3]->set_value(beacon.link.reorders);
+                beacon_link_res_tbl[i][4]->set_value(beacon.link.resyncs);
+            }
+#if BEACON_BATCH_PUBLISH
+            if (!add_beacon_batch_records(&pack, i, &beacon, values, report))
+            {
+                printf("Beacon %lu does not fit in the batch report\n", i);
+            }
+#endif
+            for (k = 0; k < BEACON_REPORT_KINDS; k++)
+            {
+                if (report & (0x1u << k))
+                {
+                    printf("Beacon %lu %s updated: %f\n", i, beacon_report_names[k] ? beacon_report_names[k] :
+                           get_beacon_schema(beacon.info.format)->res_name, values[k]);
+                }
+            }
             updated_count++;
         }
     }
 
-    pelion_data_valid_bmp->set_value((int64_t)data_valid_bmp); // safe cast: bitmap shorter than 63 bits
+#if BEACON_BATCH_PUBLISH
+    /* one notification for the whole cycle */
+    pack_len = senml_finish(&pack);
+    if (pack_len > 0)
+    {
+        beacon_batch_res->set_value(beacon_batch_payload, pack_len);
+    }
+#endif
+    beacon_report_cycle++;
+
+    static uint8_t payload[BEACON_BMP_MAX_ENCODED_LEN];
+    uint32_t payload_len = encode_beacon_validity(payload, sizeof(payload));
+
+    if ((payload_len != valid_bmp_payload_len) || memcmp(payload, valid_bmp_payload, payload_len))
+    {
+        memcpy(valid_bmp_payload, payload, payload_len);
+        valid_bmp_payload_len = payload_len;
+        pelion_data_valid_bmp->set_value(valid_bmp_payload, valid_bmp_payload_len);
+    }
 
     printf("Updated data from %lu devices sent to Pelion.\n", updated_count);
+
+    if (drops != reported_drops)
+    {
+        printf("Beacon sample ring full, %lu samples dropped (%lu total).\n", drops - reported_drops, drops);
+        reported_drops = drops;
+    }
+
+    #if BEACON_SCANNER
+    printf("Duplicate filter: %lu advertisements dropped, %lu passed.\n",
+           get_adv_dedup_hits(), get_adv_dedup_misses());
+    #endif
+    #if BEACON_SCANNER && BEACON_AUTH
+    BEACON_AUTH_STATS_T auth;
+    get_beacon_auth_stats(&auth);
+    if (auth.batches > 0)
+    {
+        printf("Beacon auth: %lu verified, %lu bad MIC, %lu replayed, %lu without key, %lu unauthenticated, %lu frames/s.\n",
+               auth.verified, auth.bad_mic, auth.replayed, auth.no_key, auth.unauthenticated,
+               (uint32_t)(auth.total_us ? (auth.verified * 1000000ull / auth.total_us) : 0));
+    }
+    #endif
 }
 
 void main_application(void)
@@ -514,6 +1111,15 @@ void main_application(void)
     SimpleM2MClient mbedClient;
     #if FEA_BLE
     GAPDevice gap_device;
+    ScannerBackend &scanner = gap_device;
+    #elif BEACON_SCANNER
+    #if defined(BEACON_REPLAY_FILE)
+    ReplayScanner replay_scanner(BEACON_REPLAY_FILE, BEACON_REPLAY_SPEED);
+    ScannerBackend &scanner = replay_scanner;
+    #else
+    HciScanner hci_scanner(BEACON_HCI_DEV);
+    ScannerBackend &scanner = hci_scanner;
+    #endif
     #endif
 
     // application_init() runs the following initializations:
@@ -546,22 +1152,82 @@ void main_application(void)
                  M2MBase::POST_ALLOWED, NULL, false, (void*)factory_reset, NULL);
 
     init_beacon_tbl();
+    init_sample_ring();
+    init_adv_dedup(BEACON_DEDUP_WINDOW_MS);
+    #if BEACON_SCANNER
+    init_scan_batch(batch_clock_us);
+    #if BEACON_AUTH
+    init_beacon_auth(batch_clock_us);
+    #endif
+    #endif
+
+    /* Warm start from the last registry checkpoint */
+    if (beacon_store_open() == 0)
+    {
+        connected_beacons = beacon_store_load();
+        printf("Restored %lu beacons from storage\n", connected_beacons);
+    }
+    #if BEACON_SCANNER && BEACON_AUTH
+    /* Keys go in before scanning starts, the scan thread only reads them. The
+       key file does not depend on the registry image. */
+    printf("Provisioned %lu beacon keys\n", beacon_store_load_keys());
+    #endif
 
     uint16_t i;
+    uint8_t f, g;
     for (i = 0; i < MAX_CONNECTED_BEACONS; i++)
     {
-        char res_name[32] = {0};
-        M2MResource* res;
+        for (f = 0; f < BEACON_FMT_COUNT; f++)
+        {
+            const BEACON_SCHEMA_T *schema = get_beacon_schema(f);
+            char res_name[32] = {0};
+
+            /* one resource per distinct object/resource pair */
+            for (g = 0; g < f; g++)
+            {
+                if ((get_beacon_schema(g)->object_id == schema->object_id) &&
+                    (get_beacon_schema(g)->resource_id == schema->resource_id))
+                {
+                    break;
+                }
+            }
+            if (g < f)
+            {
+                beacon_data_res_tbl[i][f] = beacon_data_res_tbl[i][g];
+                continue;
+            }
+
+            snprintf(res_name, sizeof(res_name), "beacon_%02x_%s", i, schema->res_name);
+            beacon_data_res_tbl[i][f] = mbedClient.add_cloud_resource(schema->object_id, i, schema->resource_id, res_name,
+                                            M2MResourceInstance::FLOAT, M2MBase::GET_PUT_ALLOWED, "", BEACON_RES_OBSERVABLE, NULL, NULL);
+        }
+
+        char rssi_name[32] = {0};
+        snprintf(rssi_name, sizeof(rssi_name), "beacon_%02x_rssi", i);
+        beacon_rssi_res_tbl[i] = mbedClient.add_cloud_resource(BEACON_LINK_OBJECT, i, BEACON_LINK_RES_RSSI, rssi_name,
+                                     M2MResourceInstance::FLOAT, M2MBase::GET_ALLOWED, "", BEACON_RES_OBSERVABLE, NULL, NULL);
 
-        sprintf(res_name, "beacon_%02x_temperature", i);
-        res = mbedClient.add_cloud_resource(3303u, i, 5700u, res_name, 
-                                        M2MResourceInstance::FLOAT, M2MBase::GET_PUT_ALLOWED, "", true, NULL, NULL);
-        beacon_data_res_tbl[i] = res;
+        char link_name[32] = {0};
+        snprintf(link_name, sizeof(link_name), "beacon_%02x_delivery", i);
+        beacon_delivery_res_tbl[i] = mbedClient.add_cloud_resource(BEACON_LINK_OBJECT, i, BEACON_LINK_RES_DELIVERY, link_name,
+                                         M2MResourceInstance::FLOAT, M2MBase::GET_ALLOWED, "", BEACON_RES_OBSERVABLE, NULL, NULL);
+        for (f = 0; f < BEACON_LINK_RES_COUNT; f++)
+        {
+            snprintf(link_name, sizeof(link_name), "beacon_%02x_%s", i, beacon_link_res_names[f]);
+            beacon_link_res_tbl[i][f] = mbedClient.add_cloud_resource(BEACON_LINK_OBJECT, i, f, link_name,
+                                            M2MResourceInstance::INTEGER, M2MBase::GET_ALLOWED, "", BEACON_RES_OBSERVABLE, NULL, NULL);
+        }
     }
 
+    #if BEACON_BATCH_PUBLISH
+    beacon_batch_res = mbedClient.add_cloud_resource(BEACON_BATCH_OBJECT, 0, 0, "beacon_batch",
+                           M2MResourceInstance::OPAQUE, M2MBase::GET_ALLOWED, NULL, true, NULL, NULL);
+    beacon_batch_res->set_coap_content_type(BEACON_SENML_CONTENT_TYPE);
+    #endif
+
     // TODO: check path, this was copied from blinking pattern resource
     pelion_data_valid_bmp = mbedClient.add_cloud_resource(3201, 0, 5853, "beacon_validity_bitmap", 
-                                M2MResourceInstance::INTEGER, M2MBase::GET_PUT_ALLOWED, 0, true, NULL, NULL);
+                                M2MResourceInstance::OPAQUE, M2MBase::GET_ALLOWED, NULL, true, NULL, NULL);
 
     mbedClient.register_and_connect();
 
@@ -570,17 +1236,40 @@ void main_application(void)
     mbedClient.get_cloud_client().on_certificate_renewal(certificate_renewal_cb);
     #endif // MBED_CONF_MBED_CLOUD_CLIENT_DISABLE_CERTIFICATE_ENROLLMENT
 
-    #if !FEA_BLE
-    uint8_t dummy_update_idx = 0;
+    #if BEACON_SCANNER
+    /* Start the scan session, it keeps running on its own thread and
+    feeds the sample ring */
+    printf("Scanning with the %s backend\n", scanner.name());
+    scanner.run();
+    #else
+    uint32_t dummy_update_idx = 0;
     #endif
+    time_t last_checkpoint = time(NULL);
+    uint32_t publish_ticks = 0;
     // Check if client is registering or registered, if true sleep and repeat.
     while (mbedClient.is_register_called())
     {
-        #if FEA_BLE
-        /* Run BLE scan procedure.
-        This also updates the beacon data tables */
-        gap_device.run();
-        #else
+        #if BEACON_SCANNER
+        /* Apply scanned samples to the beacon data tables */
+        ingest_beacon_samples();
+        /* Drop beacons that have gone silent */
+        expire_stale_beacons(time(NULL), on_beacon_evicted);
+        /* Keep the controller accept list in line with the registry */
+        scanner.stage_accept_list();
+        /* Let the scan scheduler see how many beacons are fresh */
+        uint32_t known_beacons;
+        uint32_t fresh_beacons = count_fresh_beacons(time(NULL), BEACON_FRESHNESS_DEADLINE, &known_beacons);
+        scanner.report_freshness(fresh_beacons, known_beacons);
+        #endif
+        /* Sleep until the next ingest tick, publish on its own period */
+        mcc_platform_do_wait(BEACON_INGEST_INTERVAL_MS);
+        if (++publish_ticks < (BEACON_PUBLISH_INTERVAL_MS / BEACON_INGEST_INTERVAL_MS))
+        {
+            continue;
+        }
+        publish_ticks = 0;
+
+        #if !BEACON_SCANNER
         /* Dummy version */
         if (connected_beacons < MAX_CONNECTED_BEACONS)
         {
@@ -588,7 +1277,6 @@ void main_application(void)
 
             if (tbl_idx != INVALID_U32)
             {
-                data_valid_bmp |= (0x1u << tbl_idx);
                 connected_beacons++;
             }
         }
@@ -597,8 +1285,12 @@ void main_application(void)
         #endif
         /* Update scanned/dummy BLE data to Pelion cloud */
         update_beacon_cloud_data();
-        /* Sleep for 10s */
-        mcc_platform_do_wait(10000);   
+        if (time(NULL) - last_checkpoint >= BEACON_CHECKPOINT_INTERVAL)
+        {
+            beacon_store_checkpoint();
+            last_checkpoint = time(NULL);
+        }
     }
-    // Client unregistered, exit program.
+    // Client unregistered, save registry and exit program.
+    beacon_store_close();
 }
@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <string.h>
+#include "beacon_store.h"
+#include "ble_beacon.h"
+#include "ble_beacon_auth.h"
+#include "pal.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define BEACON_STORE_FILE "beacon_registry.bin"
+#define BEACON_KEYS_FILE  "beacon_keys.txt"
+
+static char store_path[PAL_MAX_FILE_AND_FOLDER_LENGTH];
+
+// build full path of a file on the primary partition
+static int beacon_store_file_path(char *path, const char *name)
+{
+    palStatus_t status = pal_fsGetMountPoint(PAL_FS_PARTITION_PRIMARY, PAL_MAX_FILE_AND_FOLDER_LENGTH, path);
+
+    if(status != PAL_SUCCESS)
+    {
+        printf("beacon_store: fetching of PAL_FS_PARTITION_PRIMARY path failed\n");
+        return -1;
+    }
+    if(strlen(path) + 2 + strlen(name) > PAL_MAX_FILE_AND_FOLDER_LENGTH)
+    {
+        return -1;
+    }
+    strcat(path, "/");
+    strcat(path, name);
+
+    return 0;
+}
+
+// build full path of the image file on the primary partition
+static int beacon_store_path(void)
+{
+    return beacon_store_file_path(store_path, BEACON_STORE_FILE);
+}
+
+#ifdef __linux__
+
+static uint8_t *store_map = NULL;
+static uint32_t store_size = 0;
+static int store_fd = -1;
+
+// cursor over the mapping for the registry image callbacks
+typedef struct
+{
+    uint8_t *base;
+    uint32_t pos;
+} STORE_CURSOR_T;
+
+static int map_read(void *ctx, void *data, uint32_t len)
+{
+    STORE_CURSOR_T *c = (STORE_CURSOR_T *)ctx;
+
+    memcpy(data, c->base + c->pos, len);
+    c->pos += len;
+    return 0;
+}
+
+static int map_write(void *ctx, void *data, uint32_t len)
+{
+    STORE_CURSOR_T *c = (STORE_CURSOR_T *)ctx;
+
+    memcpy(c->base + c->pos, data, len);
+    c->pos += len;
+    return 0;
+}
+
+int beacon_store_open(void)
+{
+    struct stat st;
+
+    if(beacon_store_path() != 0)
+    {
+        return -1;
+    }
+
+    store_size = get_beacon_image_size();
+    store_fd = open(store_path, O_RDWR | O_CREAT, 0644);
+    if(store_fd < 0)
+    {
+        printf("beacon_store: cannot open %s\n", store_path);
+        return -1;
+    }
+
+    // image from a different build is rejected by the header check on load
+    if(fstat(store_fd, &st) != 0 || (uint32_t)st.st_size != store_size)
+    {
+        if(ftruncate(store_fd, store_size) != 0)
+        {
+            printf("beacon_store: cannot resize %s\n", store_path);
+            close(store_fd);
+            store_fd = -1;
+            return -1;
+        }
+    }
+
+    store_map = (uint8_t *)mmap(NULL, store_size, PROT_READ | PROT_WRITE, MAP_SHARED, store_fd, 0);
+    if(store_map == MAP_FAILED)
+    {
+        printf("beacon_store: cannot map %s\n", store_path);
+        store_map = NULL;
+        close(store_fd);
+        store_fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+uint32_t beacon_store_load(void)
+{
+    STORE_CURSOR_T cursor = { store_map, 0 };
+
+    if(store_map == NULL)
+    {
+        return 0;
+    }
+    return load_beacon_registry(map_read, &cursor);
+}
+
+int beacon_store_checkpoint(void)
+{
+    STORE_CURSOR_T cursor = { store_map, 0 };
+
+    if(store_map == NULL || !save_beacon_registry(map_write, &cursor))
+    {
+        return -1;
+    }
+    // let the kernel write back in the background, close() syncs
+    return msync(store_map, store_size, MS_ASYNC);
+}
+
+void beacon_store_close(void)
+{
+    if(store_map == NULL)
+    {
+        return;
+    }
+    beacon_store_checkpoint();
+    msync(store_map, store_size, MS_SYNC);
+    munmap(store_map, store_size);
+    close(store_fd);
+    store_map = NULL;
+    store_fd = -1;
+}
+
+#else // Mbed OS: stdio on the partition mounted by mcc_platform_storage_init()
+
+static uint8_t store_ready = 0;
+
+static int file_read(void *ctx, void *data, uint32_t len)
+{
+    return (fread(data, 1, len, (FILE *)ctx) == len) ? 0 : -1;
+}
+
+static int file_write(void *ctx, void *data, uint32_t len)
+{
+    return (fwrite(data, 1, len, (FILE *)ctx) == len) ? 0 : -1;
+}
+
+int beacon_store_open(void)
+{
+    if(beacon_store_path() != 0)
+    {
+        return -1;
+    }
+    store_ready = 1;
+
+    return 0;
+}
+
+// checkpoints are written to <image>.tmp first
+static void beacon_store_tmp_path(char *tmp_path, uint32_t len)
+{
+    snprintf(tmp_path, len, "%s.tmp", store_path);
+}
+
+uint32_t beacon_store_load(void)
+{
+    char tmp_path[sizeof(store_path) + 4];
+    FILE *f;
+    uint32_t restored;
+
+    if(!store_ready)
+    {
+        return 0;
+    }
+    // a reset between removing the old image and renaming the new one
+    // leaves only the complete .tmp image, put it in place
+    beacon_store_tmp_path(tmp_path, sizeof(tmp_path));
+    if((f = fopen(store_path, "rb")) == NULL)
+    {
+        if(rename(tmp_path, store_path) != 0 || (f = fopen(store_path, "rb")) == NULL)
+        {
+            return 0;
+        }
+        printf("beacon_store: recovered %s\n", tmp_path);
+    }
+    restored = load_beacon_registry(file_read, f);
+    fclose(f);
+
+    return restored;
+}
+
+int beacon_store_checkpoint(void)
+{
+    char tmp_path[sizeof(store_path) + 4];
+    FILE *f;
+    uint8_t ok;
+
+    if(!store_ready)
+    {
+        return -1;
+    }
+
+    // write a complete new image before replacing the old one
+    beacon_store_tmp_path(tmp_path, sizeof(tmp_path));
+    if((f = fopen(tmp_path, "wb")) == NULL)
+    {
+        printf("beacon_store: cannot open %s\n", tmp_path);
+        return -1;
+    }
+    ok = save_beacon_registry(file_write, f);
+    if(fclose(f) != 0 || !ok)
+    {
+        remove(tmp_path);
+        return -1;
+    }
+    remove(store_path);
+
+    return rename(tmp_path, store_path);
+}
+
+void beacon_store_close(void)
+{
+    if(store_ready)
+    {
+        beacon_store_checkpoint();
+        store_ready = 0;
+    }
+}
+
+#endif // __linux__
+
+// provision beacon keys from the key file, one "<address> <key hex>" per line
+uint32_t beacon_store_load_keys(void)
+{
+#if BEACON_AUTH
+    char path[PAL_MAX_FILE_AND_FOLDER_LENGTH];
+    char line[80];
+    uint8_t addr[BEACON_ADDR_LEN];
+    uint8_t key[BEACON_AUTH_KEY_LEN];
+    uint32_t count = 0;
+    FILE *f;
+
+    if(beacon_store_file_path(path, BEACON_KEYS_FILE) != 0 || (f = fopen(path, "r")) == NULL)
+    {
+        return 0;
+    }
+    while(fgets(line, sizeof(line), f))
+    {
+        if(parse_beacon_auth_key_line(line, addr, key) && beacon_auth_add_key(addr, key) != INVALID_U32)
+        {
+            count++;
+        }
+    }
+    memset(key, 0, sizeof(key));
+    fclose(f);
+
+    return count;
+#else
+    return 0;
+#endif
+}
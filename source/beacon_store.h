@@ -0,0 +1,34 @@
+#ifndef BEACON_STORE_H
+#define BEACON_STORE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Persistent beacon registry checkpoint on the primary storage partition.
+// On Linux the image file is mmap'd and checkpoints are memory copies into
+// the mapping, on Mbed OS the image is rewritten through a temporary file.
+
+// open (and create if missing) the registry image, returns 0 on success
+int beacon_store_open(void);
+
+// load registry from the image, returns number of restored beacons
+uint32_t beacon_store_load(void);
+
+// write the current registry to the image, returns 0 on success
+int beacon_store_checkpoint(void);
+
+// final checkpoint, flush and release the image
+void beacon_store_close(void);
+
+// provision authenticated beacon keys from beacon_keys.txt on the same
+// partition, returns number of keys added (0 without BEACON_AUTH)
+uint32_t beacon_store_load_keys(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BEACON_STORE_H
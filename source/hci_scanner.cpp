@@ -0,0 +1,229 @@
+// ----------------------------------------------------------------------------
+// Copyright 2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#if defined(__linux__)
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "hci_scanner.h"
+
+extern "C"
+{
+#include "ble_scan_batch.h"
+}
+
+/* Linux Bluetooth socket interface, from <bluetooth/hci.h> which is not
+ * part of every toolchain sysroot */
+#ifndef AF_BLUETOOTH
+#define AF_BLUETOOTH    31
+#endif
+#define BTPROTO_HCI     1
+#define SOL_HCI         0
+#define HCI_FILTER      2
+#define HCI_CHANNEL_RAW 0
+
+struct hci_scanner_sockaddr {
+    sa_family_t    hci_family;
+    unsigned short hci_dev;
+    unsigned short hci_channel;
+};
+
+struct hci_scanner_filter {
+    uint32_t type_mask;
+    uint32_t event_mask[2];
+    uint16_t opcode;
+};
+
+/* Time allowed for the controller to answer a command */
+#define HCI_COMMAND_TIMEOUT_MS 1000
+
+static uint32_t monotonic_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000u + (uint64_t)ts.tv_nsec / 1000000u);
+}
+
+HciScanner::HciScanner(int dev_id, int fd) :
+    _dev_id(dev_id),
+    _fd(fd),
+    _started(false),
+    _stop(false)
+{
+    ble_hci_rx_init(&_rx);
+}
+
+HciScanner::~HciScanner()
+{
+    stop();
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+void HciScanner::run()
+{
+    if (_started) {
+        printf("HCI scanner already running.\n");
+        return;
+    }
+
+    if (_fd < 0) {
+        _fd = open_device(_dev_id);
+        if (_fd < 0) {
+            printf("Failed to open HCI socket for hci%d\n", _dev_id);
+            return;
+        }
+    }
+
+    _stop = false;
+    if (pthread_create(&_thread, NULL, &HciScanner::thread_main, this) != 0) {
+        printf("Failed to start HCI scanner thread\n");
+        return;
+    }
+    _started = true;
+}
+
+/* The thread disables scanning on its way out */
+void HciScanner::stop()
+{
+    if (_started) {
+        __atomic_store_n(&_stop, true, __ATOMIC_RELAXED);
+        pthread_join(_thread, NULL);
+        _started = false;
+    }
+}
+
+void *HciScanner::thread_main(void *arg)
+{
+    static_cast<HciScanner *>(arg)->scan();
+    return NULL;
+}
+
+/* Raw socket bound to the adapter, passing command results and LE events */
+int HciScanner::open_device(int dev_id)
+{
+    struct hci_scanner_sockaddr addr;
+    struct hci_scanner_filter filter;
+    int fd;
+
+    fd = socket(AF_BLUETOOTH, SOCK_RAW | SOCK_CLOEXEC, BTPROTO_HCI);
+    if (fd < 0) {
+        return -1;
+    }
+
+    memset(&filter, 0, sizeof(filter));
+    filter.type_mask = 1u << BLE_HCI_EVENT_PKT;
+    filter.event_mask[0] = (1u << BLE_HCI_EVT_CMD_COMPLETE) | (1u << BLE_HCI_EVT_CMD_STATUS);
+    filter.event_mask[1] = 1u << (BLE_HCI_EVT_LE_META - 32);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.hci_family = AF_BLUETOOTH;
+    addr.hci_dev = (unsigned short)dev_id;
+    addr.hci_channel = HCI_CHANNEL_RAW;
+
+    if ((setsockopt(fd, SOL_HCI, HCI_FILTER, &filter, sizeof(filter)) < 0) ||
+        (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/* Write one command and wait for its Command Complete or Command Status,
+ * advertising reports arriving meanwhile are queued as usual */
+bool HciScanner::send_command(const uint8_t *cmd, uint32_t len, int timeout_ms)
+{
+    uint16_t opcode = (uint16_t)(cmd[1] | (cmd[2] << 8));
+    uint32_t count = _rx.cmd_count;
+    uint32_t start = monotonic_ms();
+
+    if (write(_fd, cmd, len) != (ssize_t)len) {
+        return false;
+    }
+
+    while ((monotonic_ms() - start) < (uint32_t)timeout_ms) {
+        if (ble_hci_rx_poll(&_rx, _fd, timeout_ms) == INVALID_U32) {
+            return false;
+        }
+        if ((_rx.cmd_count != count) && (_rx.cmd_opcode == opcode)) {
+            return (_rx.cmd_status == 0);
+        }
+    }
+    return false;
+}
+
+void HciScanner::scan()
+{
+    uint8_t cmd[BLE_HCI_COMMAND_MAX];
+    uint32_t len;
+    uint32_t pending;
+    uint32_t batch_start_ms = 0;
+    uint32_t now_ms;
+
+    /* a previous user may have left scanning on, its status does not matter */
+    len = ble_hci_build_set_scan_enable(cmd, 0, 0);
+    send_command(cmd, len, HCI_COMMAND_TIMEOUT_MS);
+
+    /* passive, accept all advertisers, duplicates are filtered in software so
+     * a beacon repeating its payload is still seen once per dedup window */
+    len = ble_hci_build_set_scan_params(cmd, 0, BEACON_HCI_SCAN_INTERVAL, BEACON_HCI_SCAN_WINDOW, 0);
+    if (!send_command(cmd, len, HCI_COMMAND_TIMEOUT_MS)) {
+        printf("HCI LE Set Scan Parameters failed, status 0x%02x\n", _rx.cmd_status);
+        return;
+    }
+    len = ble_hci_build_set_scan_enable(cmd, 1, 0);
+    if (!send_command(cmd, len, HCI_COMMAND_TIMEOUT_MS)) {
+        printf("HCI LE Set Scan Enable failed, status 0x%02x\n", _rx.cmd_status);
+        return;
+    }
+    printf("HCI scan started on hci%d\n", _dev_id);
+
+    while (!__atomic_load_n(&_stop, __ATOMIC_RELAXED)) {
+        if (ble_hci_rx_poll(&_rx, _fd, BEACON_BATCH_MAX_LATENCY_MS) == INVALID_U32) {
+            printf("HCI socket closed, scanning stopped\n");
+            break;
+        }
+
+        /* decode a full batch at once, leftovers wait at most the latency limit */
+        pending = get_scan_reports_pending();
+        if (pending == 0) {
+            continue;
+        }
+        now_ms = monotonic_ms();
+        if (batch_start_ms == 0) {
+            batch_start_ms = now_ms;
+        }
+        if ((pending >= BEACON_BATCH_SIZE) || ((now_ms - batch_start_ms) >= BEACON_BATCH_MAX_LATENCY_MS)) {
+            process_scan_batch(BEACON_BATCH_SIZE, now_ms);
+            batch_start_ms = (get_scan_reports_pending() > 0) ? now_ms : 0;
+        }
+    }
+
+    len = ble_hci_build_set_scan_enable(cmd, 0, 0);
+    send_command(cmd, len, HCI_COMMAND_TIMEOUT_MS);
+    printf("HCI scan stopped, %lu events, %lu advertising reports, %lu errors\n",
+           (unsigned long)_rx.events, (unsigned long)_rx.adv_reports, (unsigned long)_rx.errors);
+}
+
+#endif // __linux__
@@ -0,0 +1,76 @@
+// ----------------------------------------------------------------------------
+// Copyright 2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __HCI_SCANNER_H__
+#define __HCI_SCANNER_H__
+
+#if defined(__linux__)
+
+#include <pthread.h>
+#include "scanner_backend.h"
+
+extern "C"
+{
+#include "ble_hci.h"
+}
+
+/* Scan interval and window in 0.625 ms units, equal values scan continuously */
+#ifndef BEACON_HCI_SCAN_INTERVAL
+#define BEACON_HCI_SCAN_INTERVAL 0x0060
+#endif
+#ifndef BEACON_HCI_SCAN_WINDOW
+#define BEACON_HCI_SCAN_WINDOW   0x0060
+#endif
+
+/**
+ * Passive LE scan on a Linux Bluetooth adapter through a raw HCI socket.
+ * The scanner thread enables scanning, reads LE Advertising Report events
+ * into the report ring and runs the batch decoder, like GAPDevice does on
+ * Mbed OS. Needs CAP_NET_RAW and an adapter that bluetoothd is not already
+ * scanning with.
+ */
+class HciScanner : public ScannerBackend
+{
+public:
+    /** Scan on hci<dev_id>. If fd is given it is used as the HCI packet
+     *  stream instead, e.g. one end of a socketpair in tests. The scanner
+     *  owns and closes the fd. */
+    explicit HciScanner(int dev_id, int fd = -1);
+    virtual ~HciScanner();
+
+    virtual void run();
+    virtual void stop();
+    virtual const char *name() const { return "hci"; };
+
+private:
+    static void *thread_main(void *arg);
+    static int open_device(int dev_id);
+    void scan();
+    bool send_command(const uint8_t *cmd, uint32_t len, int timeout_ms);
+
+    int         _dev_id;
+    int         _fd;
+    pthread_t   _thread;
+    bool        _started;
+    bool        _stop;
+    BLE_HCI_RX_T _rx;
+};
+
+#endif // __linux__
+
+#endif // __HCI_SCANNER_H__
@@ -0,0 +1,199 @@
+// ----------------------------------------------------------------------------
+// Copyright 2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#if defined(__linux__)
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "replay_scanner.h"
+
+extern "C"
+{
+#include "ble_capture.h"
+#include "ble_sample_ring.h"
+#include "ble_scan_batch.h"
+}
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+ReplayScanner::ReplayScanner(const char *path, uint32_t speed) :
+    _path(path),
+    _speed(speed),
+    _started(false),
+    _stop(false),
+    _start_ns(0)
+{
+}
+
+ReplayScanner::~ReplayScanner()
+{
+    stop();
+}
+
+void ReplayScanner::run()
+{
+    if (_started) {
+        printf("Replay already running.\n");
+        return;
+    }
+
+    _stop = false;
+    if (pthread_create(&_thread, NULL, &ReplayScanner::thread_main, this) != 0) {
+        printf("Failed to start replay of %s\n", _path);
+        return;
+    }
+    _started = true;
+}
+
+void ReplayScanner::stop()
+{
+    if (_started) {
+        __atomic_store_n(&_stop, true, __ATOMIC_RELAXED);
+        pthread_join(_thread, NULL);
+        _started = false;
+    }
+}
+
+void *ReplayScanner::thread_main(void *arg)
+{
+    static_cast<ReplayScanner *>(arg)->replay();
+    return NULL;
+}
+
+/* Sleep until the capture time of the next report, scaled by the replay speed */
+void ReplayScanner::wait_until(uint32_t time_ms)
+{
+    uint64_t due_ns;
+    uint64_t now_ns;
+    struct timespec ts;
+
+    if (_speed == 0) {
+        return;
+    }
+
+    due_ns = _start_ns + (uint64_t)time_ms * 1000000ull / _speed;
+    now_ns = monotonic_ns();
+    if (due_ns > now_ns) {
+        ts.tv_sec = (time_t)((due_ns - now_ns) / 1000000000ull);
+        ts.tv_nsec = (long)((due_ns - now_ns) % 1000000000ull);
+        nanosleep(&ts, NULL);
+    }
+}
+
+/* Decode one batch once the sample ring has room for all of it, a batch
+ * yields at most one sample per report. Return false if stopped meanwhile. */
+bool ReplayScanner::process_batch(uint32_t now_ms)
+{
+    const uint32_t need = (BEACON_BATCH_SIZE < BEACON_SAMPLE_RING_SIZE) ? BEACON_BATCH_SIZE : BEACON_SAMPLE_RING_SIZE;
+    const struct timespec ts = { 0, 1000000 };
+
+    while (get_sample_ring_space() < need) {
+        if (__atomic_load_n(&_stop, __ATOMIC_RELAXED)) {
+            return false;
+        }
+        nanosleep(&ts, NULL);
+    }
+    process_scan_batch(need, now_ms);
+    return true;
+}
+
+/* Decode everything queued so far, dedup and decode see capture time */
+void ReplayScanner::flush(uint32_t now_ms)
+{
+    while ((get_scan_reports_pending() > 0) && process_batch(now_ms)) {
+    }
+}
+
+void ReplayScanner::replay()
+{
+    char line[BEACON_CAPTURE_LINE_MAX + 2];
+    BEACON_CAPTURE_REC_T rec;
+    BEACON_RAW_REPORT_T *report;
+    BEACON_BATCH_STATS_T stats;
+    uint32_t line_no = 0;
+    uint32_t skipped = 0;
+    uint32_t queued = 0;
+    uint32_t last_ms = 0;
+    uint64_t elapsed_ns;
+    FILE *f;
+
+    f = fopen(_path, "r");
+    if (f == NULL) {
+        printf("Failed to open replay capture %s\n", _path);
+        return;
+    }
+
+    printf("Replaying %s at %s\n", _path, (_speed == 0) ? "maximum speed" : "capture pace");
+    _start_ns = monotonic_ns();
+
+    while (!__atomic_load_n(&_stop, __ATOMIC_RELAXED) && fgets(line, sizeof(line), f)) {
+        line_no++;
+        if (!parse_capture_line(line, &rec)) {
+            /* comments and blank lines are not counted */
+            const char *p = line + strspn(line, " \t\r\n");
+            if ((*p != '\0') && (*p != '#')) {
+                printf("Replay line %lu malformed, skipped\n", (unsigned long)line_no);
+                skipped++;
+            }
+            continue;
+        }
+
+        /* reports queued at the same capture time form one batch */
+        if (rec.time_ms != last_ms) {
+            flush(last_ms);
+            wait_until(rec.time_ms);
+            last_ms = rec.time_ms;
+        }
+
+        report = reserve_scan_report();
+        if (report == NULL) {
+            flush(last_ms);
+            report = reserve_scan_report();
+            if (report == NULL) {
+                break;
+            }
+        }
+        memcpy(report, &rec.report, sizeof(*report));
+        if ((commit_scan_report() % BEACON_BATCH_SIZE) == 0) {
+            process_batch(last_ms);
+        }
+        queued++;
+    }
+    flush(last_ms);
+    fclose(f);
+
+    elapsed_ns = monotonic_ns() - _start_ns;
+    get_scan_batch_stats(&stats);
+    printf("Replay done: %lu reports (%lu malformed lines) in %lu.%03lu s, %lu reports/s\n",
+           (unsigned long)queued, (unsigned long)skipped,
+           (unsigned long)(elapsed_ns / 1000000000ull), (unsigned long)((elapsed_ns / 1000000ull) % 1000),
+           (unsigned long)((elapsed_ns > 0) ? (queued * 1000000000ull / elapsed_ns) : 0));
+    printf("Replay decode: %lu decoded, %lu batches, %lu us/batch avg, %lu us max, %lu samples dropped\n",
+           (unsigned long)stats.decoded, (unsigned long)stats.batches,
+           (unsigned long)((stats.batches > 0) ? (stats.total_us / stats.batches) : 0),
+           (unsigned long)stats.max_us, (unsigned long)get_sample_ring_drops());
+}
+
+#endif // __linux__
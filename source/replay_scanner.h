@@ -0,0 +1,67 @@
+// ----------------------------------------------------------------------------
+// Copyright 2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __REPLAY_SCANNER_H__
+#define __REPLAY_SCANNER_H__
+
+#if defined(__linux__)
+
+#include <pthread.h>
+#include "scanner_backend.h"
+
+/* Replay pace relative to the capture timestamps, 1 is real time, 0 replays
+ * as fast as the decode path and the sample ring consumer allow */
+#ifndef BEACON_REPLAY_SPEED
+#define BEACON_REPLAY_SPEED 1
+#endif
+
+/**
+ * Feeds a recorded advertisement capture (see ble_capture.h) through the
+ * report ring and the batch decoder, as GAPDevice does with live scan
+ * reports. Unlike a radio the replay waits for room in the sample ring
+ * before decoding a batch, so every sample of the capture reaches the
+ * registry. Prints the replay throughput when the file ends.
+ */
+class ReplayScanner : public ScannerBackend
+{
+public:
+    ReplayScanner(const char *path, uint32_t speed);
+    virtual ~ReplayScanner();
+
+    virtual void run();
+    virtual void stop();
+    virtual const char *name() const { return "replay"; };
+
+private:
+    static void *thread_main(void *arg);
+    void replay();
+    void wait_until(uint32_t time_ms);
+    void flush(uint32_t now_ms);
+    bool process_batch(uint32_t now_ms);
+
+    const char *_path;
+    uint32_t    _speed;
+    pthread_t   _thread;
+    bool        _started;
+    bool        _stop;
+    uint64_t    _start_ns;
+};
+
+#endif // __linux__
+
+#endif // __REPLAY_SCANNER_H__
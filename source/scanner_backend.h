@@ -0,0 +1,55 @@
+// ----------------------------------------------------------------------------
+// Copyright 2019 ARM Ltd.
+//
+// SPDX-License-Identifier: Apache-2.0
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ----------------------------------------------------------------------------
+
+#ifndef __SCANNER_BACKEND_H__
+#define __SCANNER_BACKEND_H__
+
+#include <stdint.h>
+
+/**
+ * Source of raw advertising reports. A backend queues reports with
+ * reserve_scan_report()/commit_scan_report() and runs process_scan_batch()
+ * on its own thread, which makes it the single producer of the sample ring.
+ * The publisher calls the other methods from the main loop.
+ */
+class ScannerBackend
+{
+public:
+    virtual ~ScannerBackend() { };
+
+    /** Start scanning, returns once the backend thread is running */
+    virtual void run() = 0;
+
+    /** Stop scanning and wait for the backend thread to finish */
+    virtual void stop() { };
+
+    /** Name for log output */
+    virtual const char *name() const = 0;
+
+    /** Registry membership changed, see get_beacon_membership_gen() */
+    virtual void stage_accept_list() { };
+
+    /** Beacons fresh within the scan deadline and beacons known */
+    virtual void report_freshness(uint32_t fresh, uint32_t known)
+    {
+        (void)fresh;
+        (void)known;
+    };
+};
+
+#endif // __SCANNER_BACKEND_H__
@@ -0,0 +1,90 @@
+#include "gtest/gtest.h"
+extern "C"
+{
+#include "ble_adv_dedup.h"
+}
+#include <stdio.h>
+#include <string.h>
+
+class TestBleAdvDedup : public testing::Test {
+    virtual void SetUp()
+    {
+        init_adv_dedup(1000);
+    }
+
+    virtual void TearDown()
+    {
+    }
+};
+
+static const uint8_t addr_a[BEACON_ADDR_LEN] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06 };
+static const uint8_t addr_b[BEACON_ADDR_LEN] = { 0x11, 0x12, 0x13, 0x14, 0x15, 0x16 };
+static const uint8_t adv_1[] = { 0x06, 0xFF, 0x59, 0x00, 0xAF, 0x07, 0x15 };
+static const uint8_t adv_2[] = { 0x06, 0xFF, 0x59, 0x00, 0xAF, 0x07, 0x16 };
+
+TEST_F(TestBleAdvDedup, ble_adv_dedup_window)
+{
+    EXPECT_EQ(0, adv_is_duplicate(addr_a, adv_1, sizeof(adv_1), 100));
+    EXPECT_EQ(1, adv_is_duplicate(addr_a, adv_1, sizeof(adv_1), 200));
+    EXPECT_EQ(1, adv_is_duplicate(addr_a, adv_1, sizeof(adv_1), 1099));
+
+    // other advertiser, same payload
+    EXPECT_EQ(0, adv_is_duplicate(addr_b, adv_1, sizeof(adv_1), 1099));
+
+    // window counts from the first report, repeats pass once per window
+    EXPECT_EQ(0, adv_is_duplicate(addr_a, adv_1, sizeof(adv_1), 1100));
+    EXPECT_EQ(1, adv_is_duplicate(addr_a, adv_1, sizeof(adv_1), 1500));
+
+    // payload change passes at once
+    EXPECT_EQ(0, adv_is_duplicate(addr_a, adv_2, sizeof(adv_2), 1501));
+    EXPECT_EQ(1, adv_is_duplicate(addr_a, adv_2, sizeof(adv_2), 1502));
+    EXPECT_EQ(0, adv_is_duplicate(addr_a, adv_1, sizeof(adv_1), 1503));
+
+    EXPECT_EQ(4u, get_adv_dedup_hits());
+    EXPECT_EQ(5u, get_adv_dedup_misses());
+}
+
+TEST_F(TestBleAdvDedup, ble_adv_dedup_wrap)
+{
+    // millisecond counter wraps around
+    EXPECT_EQ(0, adv_is_duplicate(addr_a, adv_1, sizeof(adv_1), 0xFFFFFF00u));
+    EXPECT_EQ(1, adv_is_duplicate(addr_a, adv_1, sizeof(adv_1), 0x00000100u));
+    EXPECT_EQ(0, adv_is_duplicate(addr_a, adv_1, sizeof(adv_1), 0x00000400u));
+
+    // zero window disables the filter
+    init_adv_dedup(0);
+    EXPECT_EQ(0, adv_is_duplicate(addr_a, adv_1, sizeof(adv_1), 10));
+    EXPECT_EQ(0, adv_is_duplicate(addr_a, adv_1, sizeof(adv_1), 10));
+}
+
+// 150 tags advertising every 100 ms, temperature changing every 5 s
+TEST_F(TestBleAdvDedup, ble_adv_dedup_dense)
+{
+    const uint32_t tags = 150;
+    uint8_t addr[BEACON_ADDR_LEN] = { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    uint8_t adv[sizeof(adv_1)];
+    uint32_t t;
+    uint32_t n;
+
+    memcpy(adv, adv_1, sizeof(adv));
+    for(t = 0; t < 60000; t += 100)
+    {
+        for(n = 0; n < tags; n++)
+        {
+            addr[4] = (uint8_t)(n >> 8);
+            addr[5] = (uint8_t)n;
+            adv[5]  = (uint8_t)n;
+            adv[6]  = (uint8_t)(t / 5000);
+            adv_is_duplicate(addr, adv, sizeof(adv), t + n % 100);
+        }
+    }
+
+    uint32_t hits = get_adv_dedup_hits();
+    uint32_t misses = get_adv_dedup_misses();
+
+    printf("dedup %lu tags: %lu hits, %lu misses, %.1f%% of reports dropped\n",
+           (unsigned long)tags, (unsigned long)hits, (unsigned long)misses,
+           100.0 * hits / (hits + misses));
+    EXPECT_EQ(tags * 600, hits + misses);
+    EXPECT_GT(hits, 8 * misses);
+}
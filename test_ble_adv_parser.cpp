@@ -0,0 +1,103 @@
+#include "gtest/gtest.h"
+extern "C"
+{
+#include "ble_adv_parser.h"
+}
+#include <stdio.h>
+#include <string.h>
+
+class TestBleAdvParser : public testing::Test {
+    virtual void SetUp()
+    {
+    }
+
+    virtual void TearDown()
+    {
+    }
+};
+
+// flags, complete name "bcn", manufacturer data with a beacon frame
+static const uint8_t adv_mfr[] = {
+    0x02, 0x01, 0x06,
+    0x04, 0x09, 'b', 'c', 'n',
+    0x06, 0xFF, 0x59, 0x00, 0xAF, 0x07, 0x15
+};
+
+// no flags, beacon frame in 16-bit service data, trailing zero padding
+static const uint8_t adv_svc[] = {
+    0x06, 0x16, 0xAA, 0xFE, 0xAF, 0x03, 0x20,
+    0x00, 0x00, 0x00
+};
+
+TEST_F(TestBleAdvParser, ble_adv_iterate)
+{
+    BLE_AD_ITER_T it;
+    BLE_AD_FIELD_T field;
+
+    ble_ad_iter_init(&it, adv_mfr, sizeof(adv_mfr));
+    EXPECT_EQ(1, ble_ad_iter_next(&it, &field));
+    EXPECT_EQ(BLE_AD_TYPE_FLAGS, field.type);
+    EXPECT_EQ(1, field.len);
+    EXPECT_EQ(&adv_mfr[2], field.value);
+    EXPECT_EQ(1, ble_ad_iter_next(&it, &field));
+    EXPECT_EQ(BLE_AD_TYPE_COMPLETE_NAME, field.type);
+    EXPECT_EQ(0, memcmp(field.value, "bcn", field.len));
+    EXPECT_EQ(1, ble_ad_iter_next(&it, &field));
+    EXPECT_EQ(BLE_AD_TYPE_MANUFACTURER_DATA, field.type);
+    EXPECT_EQ(5, field.len);
+    EXPECT_EQ(0, ble_ad_iter_next(&it, &field));
+    EXPECT_EQ(0, ble_ad_iter_next(&it, &field));
+
+    // padding ends the significant part
+    ble_ad_iter_init(&it, adv_svc, sizeof(adv_svc));
+    EXPECT_EQ(1, ble_ad_iter_next(&it, &field));
+    EXPECT_EQ(0, ble_ad_iter_next(&it, &field));
+
+    // empty data
+    ble_ad_iter_init(&it, adv_mfr, 0);
+    EXPECT_EQ(0, ble_ad_iter_next(&it, &field));
+}
+
+TEST_F(TestBleAdvParser, ble_adv_bounds)
+{
+    BLE_AD_ITER_T it;
+    BLE_AD_FIELD_T field;
+    BLE_ADV_PAYLOAD_T payload;
+    uint8_t data[sizeof(adv_mfr)];
+    uint32_t len;
+
+    // every truncation of a valid payload must stay inside the buffer
+    for(len = 0; len < sizeof(adv_mfr); len++)
+    {
+        ble_ad_iter_init(&it, adv_mfr, len);
+        while(ble_ad_iter_next(&it, &field))
+        {
+            EXPECT_LE(field.value + field.len, adv_mfr + len);
+        }
+        EXPECT_EQ(0, ble_adv_find_payload(adv_mfr, len, &payload));
+    }
+
+    // length byte pointing past the end
+    memcpy(data, adv_mfr, sizeof(data));
+    data[8] = 0x07;
+    EXPECT_EQ(0, ble_adv_find_payload(data, sizeof(data), &payload));
+    EXPECT_EQ(0, payload.manufacturer.len);
+}
+
+TEST_F(TestBleAdvParser, ble_adv_find)
+{
+    BLE_ADV_PAYLOAD_T payload;
+
+    EXPECT_EQ(1, ble_adv_find_payload(adv_mfr, sizeof(adv_mfr), &payload));
+    EXPECT_EQ(5, payload.manufacturer.len);
+    EXPECT_EQ(&adv_mfr[10], payload.manufacturer.value);
+    EXPECT_EQ(0, payload.service_data.len);
+
+    EXPECT_EQ(1, ble_adv_find_payload(adv_svc, sizeof(adv_svc), &payload));
+    EXPECT_EQ(0, payload.manufacturer.len);
+    EXPECT_EQ(5, payload.service_data.len);
+    EXPECT_EQ(&adv_svc[2], payload.service_data.value);
+
+    // flags only
+    EXPECT_EQ(0, ble_adv_find_payload(adv_mfr, 3, &payload));
+}
@@ -5,6 +5,7 @@ extern "C"
 }
 #include <stdio.h>
 #include <string.h>
+#include <vector>
 
 class TestBleBeacon : public testing::Test {
     virtual void SetUp()
@@ -16,11 +17,20 @@ class TestBleBeacon : public testing::Test {
     }
 };
 
+static void make_addr(uint8_t *addr, uint32_t n)
+{
+    memset(addr, 0, BEACON_ADDR_LEN);
+    addr[0] = (uint8_t)n;
+    addr[1] = (uint8_t)(n >> 8);
+    addr[5] = 0xC0;
+}
+
 TEST_F(TestBleBeacon, ble_beacon_test)
 {
     uint32_t res;
-    uint8_t i;
-    BEACON_DATA_T *p_beacon_table;
+    uint32_t i;
+    uint8_t addr[BEACON_ADDR_LEN];
+    BEACON_TBL_T *p_beacon_table;
 
     // test init_beacon_tbl() and get_beacon_tbl()
     init_beacon_tbl();
@@ -28,26 +38,604 @@ TEST_F(TestBleBeacon, ble_beacon_test)
 
     EXPECT_NE((void *) 0, p_beacon_table);
 
-    //test add_beacon(uint8_t i)
+    //test add_beacon()
     for(i = 0; i < MAX_CONNECTED_BEACONS; i++)
     {
-        EXPECT_EQ(0,add_beacon(i));
+        make_addr(addr, i);
+        EXPECT_EQ(i, add_beacon(addr, 0));
     }
-    EXPECT_EQ(INVALID_U32, add_beacon(MAX_CONNECTED_BEACONS+1));
+    make_addr(addr, MAX_CONNECTED_BEACONS + 1);
+    EXPECT_EQ(INVALID_U32, add_beacon(addr, 0));
 
-    //test delete_beacon(uint8_t tbl_idx)
+    // adding an existing beacon returns its slot
+    make_addr(addr, 3);
+    EXPECT_EQ(3u, add_beacon(addr, 0));
+
+    //test delete_beacon(uint32_t tbl_idx)
     delete_beacon(0);
-    EXPECT_EQ(0,p_beacon_table[0].element_used);
-    EXPECT_EQ(0,p_beacon_table[0].updated);
-    EXPECT_EQ(0,p_beacon_table[0].update_time);
-    EXPECT_EQ(0,p_beacon_table[0].rstp);
-    EXPECT_EQ(0,p_beacon_table[0].lat);
-    EXPECT_EQ(0,p_beacon_table[0].lon);
-    EXPECT_EQ(0,p_beacon_table[0].temp);
+    EXPECT_EQ(0,(uint8_t)p_beacon_table->info[0].element_used);
+    EXPECT_EQ(0,beacon_is_dirty(0));
+    EXPECT_EQ(0,p_beacon_table->update_time[0]);
+    EXPECT_EQ(0,p_beacon_table->info[0].rstp);
+    EXPECT_EQ(0,p_beacon_table->info[0].lat);
+    EXPECT_EQ(0,p_beacon_table->info[0].lon);
+    EXPECT_EQ(0,p_beacon_table->temp[0]);
+
+    make_addr(addr, 0);
+    EXPECT_EQ(INVALID_U32, find_beacon(addr, 0));
 
+    // freed slot is reused
+    make_addr(addr, MAX_CONNECTED_BEACONS + 1);
+    EXPECT_EQ(0u, add_beacon(addr, 0));
 
     //test update_beacon_data()
     update_beacon_data(1, 15);
-    EXPECT_FLOAT_EQ(15, p_beacon_table[1].temp);
-    
+    EXPECT_FLOAT_EQ(15, BEACON_TEMP_TO_C(p_beacon_table->temp[1]));
+
+    res = find_beacon(p_beacon_table->info[1].addr, 0);
+    EXPECT_EQ(1u, res);
+}
+
+TEST_F(TestBleBeacon, ble_beacon_key_test)
+{
+    uint8_t addr[BEACON_ADDR_LEN];
+    uint32_t a;
+    uint32_t b;
+
+    init_beacon_tbl();
+
+    // same address, different payload ID are separate beacons
+    make_addr(addr, 7);
+    a = add_beacon(addr, 1);
+    b = add_beacon(addr, 2);
+    EXPECT_NE(INVALID_U32, a);
+    EXPECT_NE(INVALID_U32, b);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(a, find_beacon(addr, 1));
+    EXPECT_EQ(b, find_beacon(addr, 2));
+    EXPECT_EQ(INVALID_U32, find_beacon(addr, 3));
+}
+
+TEST_F(TestBleBeacon, ble_beacon_churn_test)
+{
+    uint8_t addr[BEACON_ADDR_LEN];
+    uint32_t slots[MAX_CONNECTED_BEACONS];
+    uint32_t round;
+    uint32_t i;
+
+    init_beacon_tbl();
+
+    // repeatedly fill and drain the table, all remaining keys must stay reachable
+    for(round = 0; round < 8; round++)
+    {
+        for(i = 0; i < MAX_CONNECTED_BEACONS; i++)
+        {
+            make_addr(addr, round * 1000 + i);
+            slots[i] = add_beacon(addr, (uint8_t)round);
+            ASSERT_NE(INVALID_U32, slots[i]);
+        }
+        for(i = 0; i < MAX_CONNECTED_BEACONS; i += 2)
+        {
+            delete_beacon(slots[i]);
+        }
+        for(i = 0; i < MAX_CONNECTED_BEACONS; i++)
+        {
+            make_addr(addr, round * 1000 + i);
+            EXPECT_EQ((i % 2) ? slots[i] : INVALID_U32, find_beacon(addr, (uint8_t)round));
+        }
+        for(i = 1; i < MAX_CONNECTED_BEACONS; i += 2)
+        {
+            delete_beacon(slots[i]);
+        }
+    }
+}
+
+TEST_F(TestBleBeacon, ble_beacon_dirty_test)
+{
+    uint8_t addr[BEACON_ADDR_LEN];
+    uint32_t w;
+    uint32_t i;
+    uint32_t bits;
+    uint32_t seen = 0;
+
+    init_beacon_tbl();
+    for(i = 0; i < MAX_CONNECTED_BEACONS; i++)
+    {
+        make_addr(addr, i);
+        add_beacon(addr, 0);
+    }
+
+    // newly added beacons start dirty, taking a word clears it
+    for(w = 0; w < BEACON_BMP_WORDS; w++)
+    {
+        bits = take_dirty_beacons(w);
+        while(bits)
+        {
+            i = (w << 5) + beacon_ctz32(bits);
+            bits &= bits - 1;
+            EXPECT_LT(i, (uint32_t)MAX_CONNECTED_BEACONS);
+            seen++;
+        }
+        EXPECT_EQ(0u, take_dirty_beacons(w));
+    }
+    EXPECT_EQ((uint32_t)MAX_CONNECTED_BEACONS, seen);
+
+    update_beacon_data(MAX_CONNECTED_BEACONS - 1, 20);
+    EXPECT_EQ(1, beacon_is_dirty(MAX_CONNECTED_BEACONS - 1));
+    EXPECT_EQ(0, beacon_is_dirty(0));
+    dummy_update_beacon_data(0);
+    EXPECT_EQ(1, beacon_is_dirty(0));
+}
+
+TEST_F(TestBleBeacon, ble_beacon_snapshot_test)
+{
+    uint8_t addr[BEACON_ADDR_LEN];
+    BEACON_SNAPSHOT_T snap;
+    uint32_t i;
+
+    init_beacon_tbl();
+    make_addr(addr, 42);
+    i = add_beacon(addr, 5);
+    update_beacon_data(i, 31);
+
+    EXPECT_EQ(1, read_beacon_snapshot(i, &snap));
+    EXPECT_FLOAT_EQ(31, snap.temp);
+    EXPECT_EQ(5, snap.info.id);
+    EXPECT_EQ(0, memcmp(addr, snap.info.addr, BEACON_ADDR_LEN));
+    EXPECT_EQ(0u, get_beacon_tbl()->seq[i] & 1u);
+
+    delete_beacon(i);
+    EXPECT_EQ(0, read_beacon_snapshot(i, &snap));
+    EXPECT_EQ(0, read_beacon_snapshot(MAX_CONNECTED_BEACONS, &snap));
+}
+
+TEST_F(TestBleBeacon, ble_beacon_rssi_test)
+{
+    uint8_t addr[BEACON_ADDR_LEN];
+    BEACON_SNAPSHOT_T snap;
+    uint32_t i;
+    uint32_t n;
+
+    init_beacon_tbl();
+    make_addr(addr, 7);
+    i = add_beacon(addr, 1);
+    EXPECT_EQ(1, read_beacon_snapshot(i, &snap));
+    EXPECT_EQ(0.0f, snap.rssi);
+
+    // first report is taken as is, a steady signal stays put
+    for(n = 0; n < 20; n++)
+    {
+        update_beacon_rssi(i, -60);
+        read_beacon_snapshot(i, &snap);
+        EXPECT_EQ(-60.0f, snap.rssi);
+    }
+
+    // a step moves the average by 1/2^shift of the difference per report
+    update_beacon_rssi(i, -80);
+    read_beacon_snapshot(i, &snap);
+    EXPECT_NEAR(-60.0f - 20.0f / (1 << BEACON_RSSI_SHIFT), snap.rssi, 1.0f / (1 << BEACON_RSSI_FRAC_BITS));
+    for(n = 0; n < 40 << BEACON_RSSI_SHIFT; n++)
+    {
+        update_beacon_rssi(i, -80);
+    }
+    read_beacon_snapshot(i, &snap);
+    EXPECT_NEAR(-80.0f, snap.rssi, 0.5f);
+    // full range swings stay in range
+    for(n = 0; n < 16; n++)
+    {
+        update_beacon_rssi(i, (n & 1) ? -128 : 127);
+        read_beacon_snapshot(i, &snap);
+        EXPECT_GE(snap.rssi, -128.0f);
+        EXPECT_LE(snap.rssi, 127.0f);
+    }
+    EXPECT_EQ(0u, get_beacon_tbl()->seq[i] & 1u);
+
+    // a new beacon in the slot starts over
+    delete_beacon(i);
+    make_addr(addr, 8);
+    EXPECT_EQ(i, add_beacon(addr, 1));
+    update_beacon_rssi(i, -40);
+    read_beacon_snapshot(i, &snap);
+    EXPECT_EQ(-40.0f, snap.rssi);
+}
+
+TEST_F(TestBleBeacon, ble_beacon_seq_test)
+{
+    uint8_t addr[BEACON_ADDR_LEN];
+    BEACON_SNAPSHOT_T snap;
+    uint32_t i;
+    uint32_t j;
+
+    init_beacon_tbl();
+    make_addr(addr, 7);
+    i = add_beacon(addr, 1);
+    read_beacon_snapshot(i, &snap);
+    EXPECT_EQ(0, snap.link.seq_bits);
+    EXPECT_EQ(0.0f, get_beacon_delivery_ratio(&snap.link));
+
+    // 10, 11, 14: two lost
+    update_beacon_seq(i, 10, 8);
+    update_beacon_seq(i, 11, 8);
+    update_beacon_seq(i, 14, 8);
+    read_beacon_snapshot(i, &snap);
+    EXPECT_EQ(8, snap.link.seq_bits);
+    EXPECT_EQ(3u, snap.link.received);
+    EXPECT_EQ(2u, snap.link.lost);
+    EXPECT_FLOAT_EQ(60.0f, get_beacon_delivery_ratio(&snap.link));
+
+    // 13 arrives late, 14 again
+    update_beacon_seq(i, 13, 8);
+    update_beacon_seq(i, 14, 8);
+    read_beacon_snapshot(i, &snap);
+    EXPECT_EQ(1u, snap.link.reorders);
+    EXPECT_EQ(1u, snap.link.dups);
+    EXPECT_EQ(1u, snap.link.lost);
+    EXPECT_EQ(14u, snap.link.last_seq);
+    EXPECT_FLOAT_EQ(80.0f, get_beacon_delivery_ratio(&snap.link));
+
+    // half the counter range away is outside any window
+    update_beacon_seq(i, 14 + 128, 8);
+    read_beacon_snapshot(i, &snap);
+    EXPECT_EQ(1u, snap.link.resyncs);
+    EXPECT_EQ(1u, snap.link.lost);
+    EXPECT_EQ(142u, snap.link.last_seq);
+
+    // the 8-bit counter wraps, 255 -> 1 is a step of 2
+    make_addr(addr, 9);
+    j = add_beacon(addr, 1);
+    update_beacon_seq(j, 255, 8);
+    update_beacon_seq(j, 1, 8);
+    read_beacon_snapshot(j, &snap);
+    EXPECT_EQ(1u, snap.link.lost);
+    EXPECT_EQ(0u, snap.link.resyncs);
+    EXPECT_EQ(1u, snap.link.last_seq);
+
+    // 32-bit counters, a restart from 0 resyncs instead of counting loss
+    update_beacon_seq(i, 100000, 32);
+    update_beacon_seq(i, 100000 + BEACON_SEQ_WINDOW, 32);
+    read_beacon_snapshot(i, &snap);
+    EXPECT_EQ(32, snap.link.seq_bits);
+    EXPECT_EQ(2u, snap.link.received);
+    EXPECT_EQ((uint32_t)BEACON_SEQ_WINDOW - 1u, snap.link.lost);
+    update_beacon_seq(i, 0, 32);
+    update_beacon_seq(i, 0xFFFFFFFFu, 32);
+    read_beacon_snapshot(i, &snap);
+    EXPECT_EQ(1u, snap.link.resyncs);
+    EXPECT_EQ(1u, snap.link.reorders);
+    EXPECT_EQ(0u, snap.link.last_seq);
+    EXPECT_EQ(0u, get_beacon_tbl()->seq[i] & 1u);
+
+    // a new beacon in the slot starts over
+    delete_beacon(i);
+    make_addr(addr, 8);
+    EXPECT_EQ(i, add_beacon(addr, 1));
+    read_beacon_snapshot(i, &snap);
+    EXPECT_EQ(0u, snap.link.received);
+}
+
+TEST_F(TestBleBeacon, ble_beacon_history_test)
+{
+    uint8_t addr[BEACON_ADDR_LEN];
+    BEACON_HISTORY_SAMPLE_T samples[BEACON_HISTORY_SIZE + 1];
+    uint32_t i;
+    uint32_t n;
+
+    init_beacon_tbl();
+    make_addr(addr, 1);
+    i = add_beacon(addr, 0);
+    EXPECT_EQ(0u, read_beacon_history(i, samples, BEACON_HISTORY_SIZE));
+
+    update_beacon_data(i, 10);
+    update_beacon_data(i, 11);
+    n = read_beacon_history(i, samples, BEACON_HISTORY_SIZE);
+    ASSERT_EQ(2u, n);
+    EXPECT_FLOAT_EQ(10, samples[0].value);
+    EXPECT_FLOAT_EQ(11, samples[1].value);
+
+    // ring wraps, oldest samples are overwritten
+    for(n = 0; n < BEACON_HISTORY_SIZE + 3; n++)
+    {
+        update_beacon_data(i, (uint8_t)(100 + n));
+    }
+    n = read_beacon_history(i, samples, BEACON_HISTORY_SIZE + 1);
+    ASSERT_EQ((uint32_t)BEACON_HISTORY_SIZE, n);
+    EXPECT_FLOAT_EQ(100 + 3, samples[0].value);
+    EXPECT_FLOAT_EQ(100 + BEACON_HISTORY_SIZE + 2, samples[n - 1].value);
+
+    // caller buffer smaller than history gets the newest samples
+    n = read_beacon_history(i, samples, 2);
+    ASSERT_EQ(2u, n);
+    EXPECT_FLOAT_EQ(100 + BEACON_HISTORY_SIZE + 2, samples[1].value);
+
+    delete_beacon(i);
+    EXPECT_EQ(0u, read_beacon_history(i, samples, BEACON_HISTORY_SIZE));
+}
+
+static std::vector<uint32_t> evicted_slots;
+
+static void record_evicted(uint32_t tbl_idx)
+{
+    evicted_slots.push_back(tbl_idx);
+}
+
+TEST_F(TestBleBeacon, ble_beacon_expire_test)
+{
+    uint8_t addr[BEACON_ADDR_LEN];
+    time_t now = time(NULL);
+    uint32_t a;
+    uint32_t b;
+    time_t t;
+
+    init_beacon_tbl();
+    evicted_slots.clear();
+    EXPECT_EQ(0u, expire_stale_beacons(now, record_evicted));
+
+    make_addr(addr, 1);
+    a = add_beacon(addr, 0);
+    make_addr(addr, 2);
+    b = add_beacon(addr, 0);
+
+    // nothing expires before the timeout
+    for(t = now + 1; t < now + BEACON_SILENCE_TIMEOUT; t++)
+    {
+        EXPECT_EQ(0u, expire_stale_beacons(t, record_evicted));
+    }
+
+    // a keeps advertising, b goes silent
+    get_beacon_tbl()->update_time[a] = beacon_time_encode(t);
+    EXPECT_EQ(1u, expire_stale_beacons(t + 1, record_evicted));
+    ASSERT_EQ(1u, evicted_slots.size());
+    EXPECT_EQ(b, evicted_slots[0]);
+    EXPECT_EQ(0, (uint8_t)get_beacon_tbl()->info[b].element_used);
+    EXPECT_EQ(INVALID_U32, find_beacon(addr, 0));
+
+    // long pause: a is evicted in one call
+    EXPECT_EQ(1u, expire_stale_beacons(t + 10 * BEACON_SILENCE_TIMEOUT, record_evicted));
+    EXPECT_EQ(a, evicted_slots[1]);
+
+    // deleted beacons leave the wheel
+    make_addr(addr, 3);
+    a = add_beacon(addr, 0);
+    delete_beacon(a);
+    EXPECT_EQ(0u, expire_stale_beacons(t + 20 * BEACON_SILENCE_TIMEOUT, record_evicted));
+}
+
+// decode either validity encoding back to one byte per slot
+static uint32_t decode_validity(const uint8_t *buf, uint32_t len, uint8_t *valid)
+{
+    uint32_t pos = 0;
+    uint32_t i = 1;
+    uint32_t value = 0;
+
+    if(buf[0] == BEACON_BMP_RAW)
+    {
+        for(pos = 0; pos < MAX_CONNECTED_BEACONS; pos++)
+        {
+            valid[pos] = (buf[1 + (pos >> 3)] >> (pos & 7u)) & 1u;
+        }
+        return pos;
+    }
+    while(i < len)
+    {
+        uint32_t run = 0;
+        uint32_t shift = 0;
+        do
+        {
+            run |= (uint32_t)(buf[i] & 0x7Fu) << shift;
+            shift += 7;
+        } while(buf[i++] & 0x80u);
+        while(run--)
+        {
+            valid[pos++] = (uint8_t)value;
+        }
+        value = !value;
+    }
+    return pos;
+}
+
+TEST_F(TestBleBeacon, ble_beacon_validity_test)
+{
+    uint8_t addr[BEACON_ADDR_LEN];
+    uint8_t buf[BEACON_BMP_MAX_ENCODED_LEN];
+    uint8_t valid[MAX_CONNECTED_BEACONS];
+    uint32_t len;
+    uint32_t i;
+
+    init_beacon_tbl();
+
+    // empty table is a single invalid run
+    len = encode_beacon_validity(buf, sizeof(buf));
+    EXPECT_LE(len, 4u);
+    EXPECT_EQ(BEACON_BMP_RLE, buf[0]);
+    EXPECT_EQ((uint32_t)MAX_CONNECTED_BEACONS, decode_validity(buf, len, valid));
+    for(i = 0; i < MAX_CONNECTED_BEACONS; i++)
+    {
+        EXPECT_EQ(0, valid[i]);
+    }
+
+    // full table
+    for(i = 0; i < MAX_CONNECTED_BEACONS; i++)
+    {
+        make_addr(addr, i);
+        add_beacon(addr, 0);
+    }
+    len = encode_beacon_validity(buf, sizeof(buf));
+    EXPECT_EQ((uint32_t)MAX_CONNECTED_BEACONS, decode_validity(buf, len, valid));
+    for(i = 0; i < MAX_CONNECTED_BEACONS; i++)
+    {
+        EXPECT_EQ(1, valid[i]);
+    }
+
+    // every other slot is worst case for run-length, falls back to raw
+    for(i = 0; i < MAX_CONNECTED_BEACONS; i += 2)
+    {
+        delete_beacon(i);
+    }
+    len = encode_beacon_validity(buf, sizeof(buf));
+    EXPECT_LE(len, (uint32_t)BEACON_BMP_MAX_ENCODED_LEN);
+    EXPECT_EQ((uint32_t)MAX_CONNECTED_BEACONS, decode_validity(buf, len, valid));
+    for(i = 0; i < MAX_CONNECTED_BEACONS; i++)
+    {
+        EXPECT_EQ(i & 1u, valid[i]);
+        EXPECT_EQ(i & 1u, beacon_is_valid(i));
+    }
+
+    // too small buffer
+    EXPECT_EQ(0u, encode_beacon_validity(buf, 1));
+}
+
+TEST_F(TestBleBeacon, ble_beacon_compact_test)
+{
+    uint8_t addr[BEACON_ADDR_LEN];
+    BEACON_SNAPSHOT_T snap;
+    BEACON_HISTORY_SAMPLE_T sample;
+    time_t now = time(NULL);
+    uint32_t i;
+
+    init_beacon_tbl();
+    make_addr(addr, 9);
+    i = add_beacon(addr, 0);
+    update_beacon_data(i, 21);
+
+    // public API is in degrees and absolute time regardless of record format
+    ASSERT_EQ(1, read_beacon_snapshot(i, &snap));
+    EXPECT_FLOAT_EQ(21, snap.temp);
+    EXPECT_LE(snap.update_time - now, 1);
+    EXPECT_NEAR(65.0593177, BEACON_COORD_TO_DEG(snap.info.lat), 1e-5);
+    EXPECT_NEAR(-12.34, BEACON_TEMP_TO_C(BEACON_TEMP_FROM_C(-12.34)), 0.006);
+
+    // timestamps survive moving far past the 16-bit relative range,
+    // compact records report samples older than the range as time 0
+    EXPECT_EQ(now + 100000, beacon_time_decode(beacon_time_encode(now + 100000)));
+    ASSERT_EQ(1u, read_beacon_history(i, &sample, 1));
+    EXPECT_FLOAT_EQ(21, sample.value);
+    EXPECT_LE(sample.timestamp, now + 1);
+    EXPECT_EQ(0u, expire_stale_beacons(now, NULL));
+    EXPECT_EQ(1u, expire_stale_beacons(now + 100000, NULL));
+}
+
+struct image_cursor
+{
+    std::vector<uint8_t> data;
+    uint32_t pos;
+};
+
+static int image_write(void *ctx, void *data, uint32_t len)
+{
+    image_cursor *c = (image_cursor *)ctx;
+
+    c->data.insert(c->data.end(), (uint8_t *)data, (uint8_t *)data + len);
+    return 0;
+}
+
+static int image_read(void *ctx, void *data, uint32_t len)
+{
+    image_cursor *c = (image_cursor *)ctx;
+
+    if(c->pos + len > c->data.size())
+    {
+        return -1;
+    }
+    memcpy(data, &c->data[c->pos], len);
+    c->pos += len;
+    return 0;
+}
+
+TEST_F(TestBleBeacon, ble_beacon_image_test)
+{
+    uint8_t addr[BEACON_ADDR_LEN];
+    BEACON_SNAPSHOT_T snap;
+    image_cursor img;
+    uint32_t a;
+    uint32_t b;
+    uint32_t w;
+
+    init_beacon_tbl();
+    make_addr(addr, 1);
+    a = add_beacon(addr, 0);
+    make_addr(addr, 2);
+    b = add_beacon(addr, 4);
+    update_beacon_data(b, 27);
+    delete_beacon(a);
+
+    img.pos = 0;
+    ASSERT_EQ(1, save_beacon_registry(image_write, &img));
+    EXPECT_EQ(get_beacon_image_size(), img.data.size());
+
+    // warm start restores slot mapping and last value, all restored beacons are dirty
+    init_beacon_tbl();
+    EXPECT_EQ(1u, load_beacon_registry(image_read, &img));
+    EXPECT_EQ(b, find_beacon(addr, 4));
+    ASSERT_EQ(1, read_beacon_snapshot(b, &snap));
+    EXPECT_FLOAT_EQ(27, snap.temp);
+    EXPECT_EQ(1, beacon_is_valid(b));
+    EXPECT_EQ(1, beacon_is_dirty(b));
+    EXPECT_EQ(0, beacon_is_valid(a));
+    for(w = 0; w < BEACON_BMP_WORDS; w++)
+    {
+        take_dirty_beacons(w);
+    }
+
+    // freed slot is handed out again
+    make_addr(addr, 3);
+    EXPECT_EQ(a, add_beacon(addr, 0));
+
+    // corrupt image leaves an empty registry
+    img.data[img.data.size() - 1] ^= 0x55;
+    img.pos = 0;
+    EXPECT_EQ(0u, load_beacon_registry(image_read, &img));
+    EXPECT_EQ(0, read_beacon_snapshot(b, &snap));
+
+    // truncated image
+    img.data.resize(10);
+    img.pos = 0;
+    EXPECT_EQ(0u, load_beacon_registry(image_read, &img));
+}
+
+TEST_F(TestBleBeacon, ble_beacon_accept_list_test)
+{
+    BEACON_ACCEPT_ENTRY_T entries[MAX_CONNECTED_BEACONS];
+    uint8_t addr[BEACON_ADDR_LEN];
+    uint32_t gen;
+    uint32_t i;
+
+    init_beacon_tbl();
+    EXPECT_EQ(0u, get_beacon_accept_list(entries, MAX_CONNECTED_BEACONS));
+
+    gen = get_beacon_membership_gen();
+    make_addr(addr, 1);
+    EXPECT_EQ(0u, add_beacon(addr, 0));
+    EXPECT_NE(gen, get_beacon_membership_gen());
+    set_beacon_source(0, 1, 0);
+
+    // same advertiser under a second payload ID is listed once
+    EXPECT_EQ(1u, add_beacon(addr, 1));
+    set_beacon_source(1, 1, 0);
+    make_addr(addr, 2);
+    EXPECT_EQ(2u, add_beacon(addr, 0));
+
+    // updates do not change membership
+    gen = get_beacon_membership_gen();
+    update_beacon_data(2, 20);
+    EXPECT_EQ(gen, get_beacon_membership_gen());
+
+    EXPECT_EQ(2u, get_beacon_accept_list(entries, MAX_CONNECTED_BEACONS));
+    make_addr(addr, 1);
+    EXPECT_EQ(0, memcmp(entries[0].addr, addr, BEACON_ADDR_LEN));
+    EXPECT_EQ(1, entries[0].addr_type);
+    EXPECT_EQ(0, entries[1].addr_type);
+
+    // does not fit
+    EXPECT_EQ(INVALID_U32, get_beacon_accept_list(entries, 1));
+
+    delete_beacon(2);
+    EXPECT_NE(gen, get_beacon_membership_gen());
+    EXPECT_EQ(1u, get_beacon_accept_list(entries, 1));
+
+    for(i = 0; i < MAX_CONNECTED_BEACONS; i++)
+    {
+        make_addr(addr, 100 + i);
+        add_beacon(addr, 0);
+    }
+    EXPECT_EQ((uint32_t)MAX_CONNECTED_BEACONS - 1, get_beacon_accept_list(entries, MAX_CONNECTED_BEACONS));
 }
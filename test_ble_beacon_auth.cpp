@@ -0,0 +1,304 @@
+#include "gtest/gtest.h"
+extern "C"
+{
+#include "ble_adv_dedup.h"
+#include "ble_beacon_auth.h"
+#include "ble_beacon_schema.h"
+#include "ble_sample_ring.h"
+#include "ble_scan_batch.h"
+}
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+// needs mbedTLS, build with BEACON_AUTH=1 to run
+#if BEACON_AUTH
+#include "mbedtls/ccm.h"
+
+static uint32_t test_clock_us()
+{
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const uint8_t test_key[BEACON_AUTH_KEY_LEN] = {
+    0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F
+};
+
+class TestBleBeaconAuth : public testing::Test {
+    virtual void SetUp()
+    {
+        init_adv_dedup(1000);
+        init_sample_ring();
+        init_scan_batch(NULL);
+        init_beacon_auth(test_clock_us);
+    }
+
+    virtual void TearDown()
+    {
+        // keys would turn plain frames of other suites into downgrades
+        init_beacon_auth(NULL);
+    }
+};
+
+static void make_addr(uint8_t *addr, uint8_t n)
+{
+    memset(addr, 0xC0, BEACON_ADDR_LEN);
+    addr[0] = n;
+}
+
+// signed tag frame as a beacon with key would send it
+static void make_auth_report(BEACON_RAW_REPORT_T *r, uint8_t n, const uint8_t *key, uint8_t id, uint8_t temp,
+                             uint32_t counter)
+{
+    mbedtls_ccm_context ccm;
+    uint8_t nonce[BEACON_AUTH_NONCE_LEN];
+    uint8_t *v;
+
+    memset(r, 0, sizeof(*r));
+    make_addr(r->addr, n);
+    r->addr_type = 1;
+    r->rssi = -50;
+    r->len = 3 + 2 + BEACON_AUTH_FRAME_LEN;
+    r->data[0] = 0x02;
+    r->data[1] = 0x01;
+    r->data[2] = 0x06;
+    r->data[3] = 1 + BEACON_AUTH_FRAME_LEN;
+    r->data[4] = 0xFF;
+    v = &r->data[5];
+    v[0] = 0x59;
+    v[1] = 0x00;
+    v[2] = 0xAE;
+    v[3] = id;
+    v[4] = temp;
+    v[5] = (uint8_t)counter;
+    v[6] = (uint8_t)(counter >> 8);
+    v[7] = (uint8_t)(counter >> 16);
+    v[8] = (uint8_t)(counter >> 24);
+
+    memset(nonce, 0, sizeof(nonce));
+    memcpy(nonce, r->addr, BEACON_ADDR_LEN);
+    memcpy(&nonce[BEACON_ADDR_LEN], &v[5], 4);
+    nonce[BEACON_ADDR_LEN + 4] = id;
+
+    mbedtls_ccm_init(&ccm);
+    mbedtls_ccm_setkey(&ccm, MBEDTLS_CIPHER_ID_AES, key, BEACON_AUTH_KEY_LEN * 8);
+    mbedtls_ccm_encrypt_and_tag(&ccm, 0, nonce, sizeof(nonce), v, BEACON_AUTH_MIC_OFF, NULL, NULL,
+                                &v[BEACON_AUTH_MIC_OFF], BEACON_AUTH_MIC_LEN);
+    mbedtls_ccm_free(&ccm);
+}
+
+// plain tag frame
+static void make_plain_report(BEACON_RAW_REPORT_T *r, uint8_t n, uint8_t temp)
+{
+    static const uint8_t adv[] = { 0x02, 0x01, 0x06, 0x06, 0xFF, 0x59, 0x00, 0xAF, 0x00, 0x00 };
+
+    memset(r, 0, sizeof(*r));
+    make_addr(r->addr, n);
+    r->len = sizeof(adv);
+    memcpy(r->data, adv, sizeof(adv));
+    r->data[8] = n;
+    r->data[9] = temp;
+}
+
+static uint8_t verify_one(const BEACON_RAW_REPORT_T *r)
+{
+    BEACON_READING_T reading;
+    BEACON_AUTH_JOB_T job;
+
+    if(!decode_beacon_adv(r->data, r->len, &reading))
+    {
+        return 0;
+    }
+    job.report = r;
+    job.format = reading.format;
+    job.ok = 0;
+    verify_beacon_auth_batch(&job, 1);
+    return job.ok;
+}
+
+TEST_F(TestBleBeaconAuth, ble_beacon_auth_key_line)
+{
+    uint8_t addr[BEACON_ADDR_LEN];
+    uint8_t key[BEACON_AUTH_KEY_LEN];
+
+    ASSERT_EQ(1, parse_beacon_auth_key_line("c0:c0:c0:c0:c0:01 404142434445464748494a4b4c4d4e4F\n", addr, key));
+    EXPECT_EQ(0x01, addr[0]);
+    EXPECT_EQ(0xC0, addr[5]);
+    EXPECT_EQ(0, memcmp(key, test_key, sizeof(key)));
+
+    EXPECT_EQ(0, parse_beacon_auth_key_line("# address key", addr, key));
+    EXPECT_EQ(0, parse_beacon_auth_key_line("", addr, key));
+    EXPECT_EQ(0, parse_beacon_auth_key_line("c0:c0:c0:c0:c0:01 404142", addr, key));
+    EXPECT_EQ(0, parse_beacon_auth_key_line("c0:c0:c0:c0:c0 404142434445464748494a4b4c4d4e4f", addr, key));
+    EXPECT_EQ(0, parse_beacon_auth_key_line("c0:c0:c0:c0:c0:01 404142434445464748494a4b4c4d4e4f00", addr, key));
+}
+
+TEST_F(TestBleBeaconAuth, ble_beacon_auth_verify)
+{
+    BEACON_RAW_REPORT_T r;
+    BEACON_AUTH_STATS_T stats;
+    uint8_t addr[BEACON_ADDR_LEN];
+    uint8_t other_key[BEACON_AUTH_KEY_LEN];
+
+    make_addr(addr, 1);
+    EXPECT_EQ(0u, beacon_auth_add_key(addr, test_key));
+    EXPECT_EQ(1, beacon_auth_has_key(addr));
+
+    make_auth_report(&r, 1, test_key, 4, 22, 100);
+    EXPECT_EQ(1, verify_one(&r));
+    // same frame again is fine, an older counter is not
+    EXPECT_EQ(1, verify_one(&r));
+    make_auth_report(&r, 1, test_key, 4, 22, 99);
+    EXPECT_EQ(0, verify_one(&r));
+    make_auth_report(&r, 1, test_key, 4, 23, 101);
+    EXPECT_EQ(1, verify_one(&r));
+
+    // tampered value, MIC, counter
+    make_auth_report(&r, 1, test_key, 4, 23, 102);
+    r.data[9]++;
+    EXPECT_EQ(0, verify_one(&r));
+    make_auth_report(&r, 1, test_key, 4, 23, 102);
+    r.data[r.len - 1] ^= 0x01;
+    EXPECT_EQ(0, verify_one(&r));
+    make_auth_report(&r, 1, test_key, 4, 23, 102);
+    r.data[10]++;
+    EXPECT_EQ(0, verify_one(&r));
+
+    // wrong key, replayed under another address, no key at all
+    memcpy(other_key, test_key, sizeof(other_key));
+    other_key[0] ^= 0x80;
+    make_auth_report(&r, 1, other_key, 4, 23, 103);
+    EXPECT_EQ(0, verify_one(&r));
+    make_auth_report(&r, 1, test_key, 4, 23, 103);
+    r.addr[5] = 0x11;
+    EXPECT_EQ(0, verify_one(&r));
+    make_auth_report(&r, 2, test_key, 4, 23, 103);
+    EXPECT_EQ(0, verify_one(&r));
+
+    // keyed beacons cannot fall back to plain frames, others can
+    make_plain_report(&r, 1, 30);
+    EXPECT_EQ(0, verify_one(&r));
+    make_plain_report(&r, 2, 30);
+    EXPECT_EQ(!BEACON_AUTH_REQUIRED, verify_one(&r));
+
+    get_beacon_auth_stats(&stats);
+    EXPECT_EQ(3u, stats.verified);
+    EXPECT_EQ(4u, stats.bad_mic);
+    EXPECT_EQ(1u, stats.replayed);
+    EXPECT_EQ(2u, stats.no_key);
+    EXPECT_EQ(1u + BEACON_AUTH_REQUIRED, stats.unauthenticated);
+}
+
+TEST_F(TestBleBeaconAuth, ble_beacon_auth_keys_full)
+{
+    uint8_t addr[BEACON_ADDR_LEN];
+    uint32_t i;
+
+    for(i = 0; i < BEACON_AUTH_KEYS; i++)
+    {
+        make_addr(addr, (uint8_t)i);
+        EXPECT_EQ(i, beacon_auth_add_key(addr, test_key));
+    }
+    // replacing a key reuses its slot
+    make_addr(addr, 0);
+    EXPECT_EQ(0u, beacon_auth_add_key(addr, test_key));
+    make_addr(addr, (uint8_t)BEACON_AUTH_KEYS);
+    EXPECT_EQ(INVALID_U32, beacon_auth_add_key(addr, test_key));
+    EXPECT_EQ(0, beacon_auth_has_key(addr));
+}
+
+// the spoofable fixed-offset fallback is off in authenticated builds
+TEST_F(TestBleBeaconAuth, ble_beacon_auth_no_legacy)
+{
+    static const uint8_t adv_legacy[] = {
+        0x02, 0x01, 0x06,
+        0x0A, 0xFF, 0x59, 0x00, 0x01, 0x02, 0x03, 0xAF, 0x07, 0x15, 0x00
+    };
+    BEACON_READING_T r;
+
+    EXPECT_EQ(0, BEACON_LEGACY_TAG);
+    EXPECT_EQ(0, decode_beacon_adv(adv_legacy, sizeof(adv_legacy), &r));
+}
+
+// authenticated frames only reach the sample ring once verified
+TEST_F(TestBleBeaconAuth, ble_beacon_auth_scan_batch)
+{
+    BEACON_RAW_REPORT_T *r;
+    BEACON_SAMPLE_T s;
+    uint8_t addr[BEACON_ADDR_LEN];
+    uint32_t i;
+
+    make_addr(addr, 1);
+    beacon_auth_add_key(addr, test_key);
+
+    for(i = 0; i < 20; i++)
+    {
+        r = reserve_scan_report();
+        ASSERT_TRUE(r != NULL);
+        if(i == 5)
+        {
+            make_auth_report(r, 1, test_key, 9, 25, i);
+            r->data[9]++;
+        }
+        else if(i % 2)
+        {
+            make_auth_report(r, 1, test_key, 9, (uint8_t)i, i);
+        }
+        else
+        {
+            make_plain_report(r, (uint8_t)(100 + i), (uint8_t)i);
+        }
+        commit_scan_report();
+    }
+    EXPECT_EQ(20u, process_scan_batch(20, 0));
+
+    for(i = 0; i < 20; i++)
+    {
+        if((i == 5) || (BEACON_AUTH_REQUIRED && (i % 2) == 0))
+        {
+            continue;
+        }
+        ASSERT_EQ(1, pop_beacon_sample(&s));
+        EXPECT_EQ((float)i, s.value);
+        EXPECT_EQ((i % 2) ? BEACON_FMT_BEACON_TAG_AUTH : BEACON_FMT_BEACON_TAG, s.format);
+    }
+    EXPECT_EQ(0, pop_beacon_sample(&s));
+}
+
+// full batches over every keyed beacon all verify, the statistics add up
+TEST_F(TestBleBeaconAuth, ble_beacon_auth_batches)
+{
+    const uint32_t frames = 4 * BEACON_BATCH_SIZE;
+    const uint32_t beacons = BEACON_AUTH_KEYS;
+    static BEACON_RAW_REPORT_T reports[BEACON_AUTH_KEYS];
+    BEACON_AUTH_JOB_T jobs[BEACON_BATCH_SIZE];
+    BEACON_AUTH_STATS_T stats;
+    uint8_t addr[BEACON_ADDR_LEN];
+    uint32_t i;
+    uint32_t n;
+
+    for(i = 0; i < beacons; i++)
+    {
+        make_addr(addr, (uint8_t)i);
+        beacon_auth_add_key(addr, test_key);
+        make_auth_report(&reports[i], (uint8_t)i, test_key, 1, 20, 1);
+    }
+
+    for(i = 0; i < frames; i += BEACON_BATCH_SIZE)
+    {
+        for(n = 0; n < BEACON_BATCH_SIZE; n++)
+        {
+            jobs[n].report = &reports[(i + n) % beacons];
+            jobs[n].format = BEACON_FMT_BEACON_TAG_AUTH;
+        }
+        EXPECT_EQ((uint32_t)BEACON_BATCH_SIZE, verify_beacon_auth_batch(jobs, BEACON_BATCH_SIZE));
+    }
+
+    get_beacon_auth_stats(&stats);
+    EXPECT_EQ(frames, stats.verified);
+    EXPECT_EQ(frames / BEACON_BATCH_SIZE, stats.batches);
+    EXPECT_EQ(0u, stats.bad_mic + stats.replayed + stats.no_key + stats.unauthenticated);
+}
+
+#endif // BEACON_AUTH
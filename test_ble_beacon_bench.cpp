@@ -0,0 +1,239 @@
+#include "gtest/gtest.h"
+extern "C"
+{
+#include "ble_beacon.h"
+}
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+// Compares an array-of-structs beacon record with the struct-of-arrays
+// layout of BEACON_TBL_T on the two hot paths: the publisher sweep and the
+// per-advertisement update. The registry is sized at compile time, so both
+// layouts are modelled here at 1k and 10k beacons with the field types of
+// BEACON_TBL_T. Both sides run the same loops over the same beacons, the only
+// difference is where the fields live.
+
+#define CACHE_LINE_BYTES (64u)
+
+typedef BEACON_TBL_T TBL;
+
+// every per-beacon field of BEACON_TBL_T in one record
+typedef struct
+{
+    __typeof__(((TBL *)0)->temp[0]) temp;
+    __typeof__(((TBL *)0)->update_time[0]) update_time;
+    __typeof__(((TBL *)0)->seq[0]) seq;
+    __typeof__(((TBL *)0)->hist_head[0]) hist_head;
+    __typeof__(((TBL *)0)->hist_count[0]) hist_count;
+    __typeof__(((TBL *)0)->rssi_avg[0]) rssi_avg;
+    BEACON_INFO_T info;
+    BEACON_LINK_T link;
+} AOS_BEACON_T;
+
+// hot arrays of BEACON_TBL_T, everything before the cold info/link arrays
+#define HOT_BYTES_PER_BEACON  (offsetof(TBL, info) / MAX_CONNECTED_BEACONS)
+#define COLD_BYTES_PER_BEACON ((sizeof(TBL) - offsetof(TBL, info)) / MAX_CONNECTED_BEACONS)
+
+struct SoaBeacons
+{
+    std::vector<__typeof__(((TBL *)0)->temp[0])> temp;
+    std::vector<__typeof__(((TBL *)0)->update_time[0])> update_time;
+    std::vector<__typeof__(((TBL *)0)->seq[0])> seq;
+    std::vector<BEACON_INFO_T> info;
+    std::vector<BEACON_LINK_T> link;
+
+    explicit SoaBeacons(uint32_t n) :
+        temp(n), update_time(n), seq(n), info(n), link(n) { }
+};
+
+class TestBleBeaconBench : public testing::Test {
+    virtual void SetUp()
+    {
+    }
+
+    virtual void TearDown()
+    {
+    }
+};
+
+static uint32_t lines_for(uint32_t bytes)
+{
+    return (bytes + CACHE_LINE_BYTES - 1) / CACHE_LINE_BYTES;
+}
+
+// xorshift, deterministic across runs
+static uint32_t next_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start, uint32_t ops)
+{
+    std::chrono::duration<double, std::nano> d = std::chrono::steady_clock::now() - start;
+
+    return d.count() / ops;
+}
+
+static void run_layout_bench(uint32_t n)
+{
+    const uint32_t rounds = 200;
+    const uint32_t reports = 1000000;
+    std::vector<AOS_BEACON_T> aos(n);
+    SoaBeacons soa(n);
+    std::vector<uint32_t> idx(reports);
+    std::vector<uint32_t> dirty((n + 31) / 32);
+    uint32_t seed = 0x1234567u;
+    uint32_t r;
+    uint32_t w;
+    uint32_t bits;
+    uint32_t i;
+    volatile float sink = 0;
+
+    for(i = 0; i < reports; i++)
+    {
+        idx[i] = next_rand(&seed) % n;
+    }
+    // same ~10% of the beacons changed per publish cycle for both layouts
+    for(i = 0; i < n; i += 10)
+    {
+        dirty[i >> 5] |= 0x1u << (i & 31u);
+    }
+    for(i = 0; i < n; i++)
+    {
+        aos[i].info.element_used = 1;
+        soa.info[i].element_used = 1;
+    }
+
+    // SRAM
+    uint32_t aos_bytes = n * sizeof(AOS_BEACON_T);
+    uint32_t soa_hot = n * HOT_BYTES_PER_BEACON;
+    uint32_t soa_bytes = soa_hot + n * COLD_BYTES_PER_BEACON;
+
+    // scan update path: random beacon gets a new sample under its seqlock
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for(r = 0; r < reports; r++)
+    {
+        AOS_BEACON_T *b = &aos[idx[r]];
+        b->seq++;
+        b->temp = BEACON_TEMP_FROM_C((float)(r & 0xFF));
+        b->update_time = r;
+        b->seq++;
+    }
+    double aos_update = elapsed_ns(t0, reports);
+
+    t0 = std::chrono::steady_clock::now();
+    for(r = 0; r < reports; r++)
+    {
+        i = idx[r];
+        soa.seq[i]++;
+        soa.temp[i] = BEACON_TEMP_FROM_C((float)(r & 0xFF));
+        soa.update_time[i] = r;
+        soa.seq[i]++;
+    }
+    double soa_update = elapsed_ns(t0, reports);
+
+    // full sweep over every beacon, as count_fresh_beacons() does
+    t0 = std::chrono::steady_clock::now();
+    for(r = 0; r < rounds; r++)
+    {
+        for(i = 0; i < n; i++)
+        {
+            sink = sink + BEACON_TEMP_TO_C(aos[i].temp) + (float)aos[i].update_time;
+        }
+    }
+    double aos_sweep = elapsed_ns(t0, rounds) / 1000.0;
+
+    t0 = std::chrono::steady_clock::now();
+    for(r = 0; r < rounds; r++)
+    {
+        for(i = 0; i < n; i++)
+        {
+            sink = sink + BEACON_TEMP_TO_C(soa.temp[i]) + (float)soa.update_time[i];
+        }
+    }
+    double soa_sweep = elapsed_ns(t0, rounds) / 1000.0;
+
+    // publisher sweep over the same dirty set
+    t0 = std::chrono::steady_clock::now();
+    for(r = 0; r < rounds; r++)
+    {
+        for(w = 0; w < dirty.size(); w++)
+        {
+            for(bits = dirty[w]; bits; bits &= bits - 1)
+            {
+                sink = sink + BEACON_TEMP_TO_C(aos[(w << 5) + beacon_ctz32(bits)].temp);
+            }
+        }
+    }
+    double aos_dirty = elapsed_ns(t0, rounds) / 1000.0;
+
+    t0 = std::chrono::steady_clock::now();
+    for(r = 0; r < rounds; r++)
+    {
+        for(w = 0; w < dirty.size(); w++)
+        {
+            for(bits = dirty[w]; bits; bits &= bits - 1)
+            {
+                sink = sink + BEACON_TEMP_TO_C(soa.temp[(w << 5) + beacon_ctz32(bits)]);
+            }
+        }
+    }
+    double soa_dirty = elapsed_ns(t0, rounds) / 1000.0;
+
+    // cache lines touched by one full sweep of temp and update_time
+    uint32_t aos_sweep_lines = lines_for(aos_bytes);
+    uint32_t soa_sweep_lines = lines_for(n * sizeof(soa.temp[0])) + lines_for(n * sizeof(soa.update_time[0]));
+
+    printf("beacons %lu: record %lu B -> hot %lu B + cold %lu B\n",
+           (unsigned long)n, (unsigned long)sizeof(AOS_BEACON_T),
+           (unsigned long)HOT_BYTES_PER_BEACON, (unsigned long)COLD_BYTES_PER_BEACON);
+    printf("  SRAM            AoS %7lu B   SoA %7lu B (hot working set %lu B)\n",
+           (unsigned long)aos_bytes, (unsigned long)soa_bytes, (unsigned long)soa_hot);
+    printf("  sweep lines     AoS %7lu     SoA %7lu\n",
+           (unsigned long)aos_sweep_lines, (unsigned long)soa_sweep_lines);
+    printf("  full sweep      AoS %7.2f us SoA %7.2f us\n", aos_sweep, soa_sweep);
+    printf("  dirty sweep     AoS %7.2f us SoA %7.2f us\n", aos_dirty, soa_dirty);
+    printf("  scan update     AoS %7.2f ns SoA %7.2f ns\n", aos_update, soa_update);
+
+    EXPECT_LE(soa_bytes, aos_bytes);
+    EXPECT_LT(soa_sweep_lines, aos_sweep_lines);
+    (void)sink;
+}
+
+TEST_F(TestBleBeaconBench, ble_beacon_layout_1k)
+{
+    run_layout_bench(1000);
+}
+
+TEST_F(TestBleBeaconBench, ble_beacon_layout_10k)
+{
+    run_layout_bench(10000);
+}
+
+// static SRAM of the registry as compiled, build with BEACON_COMPACT_RECORDS=1
+// to compare the compact record mode
+TEST_F(TestBleBeaconBench, ble_beacon_footprint)
+{
+    const uint32_t budget = 64 * 1024;
+    uint32_t bytes = get_beacon_registry_bytes();
+    uint32_t per_beacon = (bytes + MAX_CONNECTED_BEACONS - 1) / MAX_CONNECTED_BEACONS;
+
+    printf("registry (%s records, history %d): %lu B for %d beacons, %lu B/beacon, %lu beacons in %lu B\n",
+           BEACON_COMPACT_RECORDS ? "compact" : "float", BEACON_HISTORY_SIZE,
+           (unsigned long)bytes, MAX_CONNECTED_BEACONS, (unsigned long)per_beacon,
+           (unsigned long)(budget / per_beacon), (unsigned long)budget);
+    printf("  hot %lu B, cold %lu B, history sample %lu B\n",
+           (unsigned long)HOT_BYTES_PER_BEACON, (unsigned long)COLD_BYTES_PER_BEACON,
+           (unsigned long)sizeof(BEACON_HISTORY_REC_T));
+
+    EXPECT_GT(bytes, 0u);
+}
@@ -0,0 +1,209 @@
+#include "gtest/gtest.h"
+extern "C"
+{
+#include "ble_beacon_schema.h"
+}
+#include <stdio.h>
+#include <string.h>
+
+class TestBleBeaconSchema : public testing::Test {
+    virtual void SetUp()
+    {
+    }
+
+    virtual void TearDown()
+    {
+    }
+};
+
+// tag frame in manufacturer data, any company ID
+static const uint8_t adv_tag[] = {
+    0x02, 0x01, 0x06,
+    0x04, 0x09, 'b', 'c', 'n',
+    0x06, 0xFF, 0x59, 0x00, 0xAF, 0x07, 0x15
+};
+
+// tag frame as read by the original firmware: tag, ID and temperature at raw
+// offsets 10, 11, 12, three bytes after the company ID
+static const uint8_t adv_tag_legacy[] = {
+    0x02, 0x01, 0x06,
+    0x0A, 0xFF, 0x59, 0x00, 0x01, 0x02, 0x03, 0xAF, 0x07, 0x15, 0x00
+};
+
+// tag frame in service data under the Eddystone UUID
+static const uint8_t adv_tag_svc[] = {
+    0x06, 0x16, 0xAA, 0xFE, 0xAF, 0x03, 0x20
+};
+
+// iBeacon, major 0x0102, minor 0x0304, measured power -59 dBm
+static const uint8_t adv_ibeacon[] = {
+    0x02, 0x01, 0x06,
+    0x1A, 0xFF, 0x4C, 0x00, 0x02, 0x15,
+    0xE2, 0xC5, 0x6D, 0xB5, 0xDF, 0xFB, 0x48, 0xD2, 0xB0, 0x60, 0xD0, 0xF5, 0xA7, 0x10, 0x96, 0xE0,
+    0x01, 0x02, 0x03, 0x04, 0xC5
+};
+
+// Eddystone-TLM, 3000 mV, -2.5 C
+static const uint8_t adv_tlm[] = {
+    0x02, 0x01, 0x06,
+    0x03, 0x03, 0xAA, 0xFE,
+    0x11, 0x16, 0xAA, 0xFE, 0x20, 0x00, 0x0B, 0xB8, 0xFD, 0x80,
+    0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x01, 0x00
+};
+
+// RuuviTag RAWv2, 24.3 C
+static const uint8_t adv_ruuvi[] = {
+    0x02, 0x01, 0x06,
+    0x1B, 0xFF, 0x99, 0x04, 0x05, 0x12, 0xFC, 0x53, 0x94, 0xC3, 0x7C, 0x00, 0x04, 0xFF, 0xFC,
+    0x04, 0x0C, 0xAC, 0x36, 0x42, 0x00, 0xCD, 0xCB, 0xB8, 0x33, 0x4C, 0x88, 0x4F
+};
+
+TEST_F(TestBleBeaconSchema, ble_beacon_schema_decode)
+{
+    BEACON_READING_T r;
+
+    EXPECT_EQ(1, decode_beacon_adv(adv_tag, sizeof(adv_tag), &r));
+    EXPECT_EQ(BEACON_FMT_BEACON_TAG, r.format);
+    EXPECT_EQ(0x07, r.id);
+    EXPECT_FLOAT_EQ(21.0f, r.value);
+    EXPECT_EQ(0, r.seq_bits);
+
+    // keyed row for the UUID does not match, falls back to the tag row
+    EXPECT_EQ(1, decode_beacon_adv(adv_tag_svc, sizeof(adv_tag_svc), &r));
+    EXPECT_EQ(BEACON_FMT_BEACON_TAG_SVC, r.format);
+    EXPECT_EQ(0x03, r.id);
+    EXPECT_FLOAT_EQ(32.0f, r.value);
+
+    EXPECT_EQ(1, decode_beacon_adv(adv_ibeacon, sizeof(adv_ibeacon), &r));
+    EXPECT_EQ(BEACON_FMT_IBEACON, r.format);
+    EXPECT_EQ(0x04, r.id);
+    EXPECT_FLOAT_EQ(-59.0f, r.value);
+
+    EXPECT_EQ(1, decode_beacon_adv(adv_tlm, sizeof(adv_tlm), &r));
+    EXPECT_EQ(BEACON_FMT_EDDYSTONE_TLM, r.format);
+    EXPECT_EQ(0, r.id);
+    EXPECT_FLOAT_EQ(-2.5f, r.value);
+    EXPECT_EQ(32, r.seq_bits);
+    EXPECT_EQ(16u, r.seq);
+
+    EXPECT_EQ(1, decode_beacon_adv(adv_ruuvi, sizeof(adv_ruuvi), &r));
+    EXPECT_EQ(BEACON_FMT_RUUVI_RAWV2, r.format);
+    EXPECT_NEAR(24.3f, r.value, 0.001f);
+    EXPECT_EQ(16, r.seq_bits);
+    EXPECT_EQ(205u, r.seq);
+}
+
+TEST_F(TestBleBeaconSchema, ble_beacon_schema_seq)
+{
+    BEACON_READING_T r;
+    uint8_t data[sizeof(adv_tag) + 1];
+
+    // tag frames may append a counter byte
+    memcpy(data, adv_tag, sizeof(adv_tag));
+    data[8]++;
+    data[sizeof(adv_tag)] = 0xFE;
+    ASSERT_EQ(1, decode_beacon_adv(data, sizeof(data), &r));
+    EXPECT_EQ(BEACON_FMT_BEACON_TAG, r.format);
+    EXPECT_FLOAT_EQ(21.0f, r.value);
+    EXPECT_EQ(8, r.seq_bits);
+    EXPECT_EQ(0xFEu, r.seq);
+
+    // iBeacon has no counter
+    ASSERT_EQ(1, decode_beacon_adv(adv_ibeacon, sizeof(adv_ibeacon), &r));
+    EXPECT_EQ(0, r.seq_bits);
+    EXPECT_EQ(0u, r.seq);
+}
+
+TEST_F(TestBleBeaconSchema, ble_beacon_schema_legacy)
+{
+    BEACON_READING_T r;
+    uint8_t data[sizeof(adv_tag_legacy)];
+
+#if BEACON_LEGACY_TAG
+    ASSERT_EQ(1, decode_beacon_adv(adv_tag_legacy, sizeof(adv_tag_legacy), &r));
+    EXPECT_EQ(BEACON_FMT_BEACON_TAG, r.format);
+    EXPECT_EQ(0x07, r.id);
+    EXPECT_FLOAT_EQ(21.0f, r.value);
+    EXPECT_EQ(0, r.seq_bits);
+
+    // the original firmware did not look at the AD structures either
+    memcpy(data, adv_tag_legacy, sizeof(data));
+    data[3] = 0x30;
+    ASSERT_EQ(1, decode_beacon_adv(data, sizeof(data), &r));
+    EXPECT_EQ(0x07, r.id);
+#else
+    EXPECT_EQ(0, decode_beacon_adv(adv_tag_legacy, sizeof(adv_tag_legacy), &r));
+#endif
+
+    // it wanted more than 13 bytes and the tag at offset 10
+    EXPECT_EQ(0, decode_beacon_adv(adv_tag_legacy, BEACON_LEGACY_MIN_LEN - 1, &r));
+    memcpy(data, adv_tag_legacy, sizeof(data));
+    data[BEACON_LEGACY_TAG_OFFSET] = 0xAD;
+    EXPECT_EQ(0, decode_beacon_adv(data, sizeof(data), &r));
+}
+
+TEST_F(TestBleBeaconSchema, ble_beacon_schema_reject)
+{
+    BEACON_READING_T r;
+    uint8_t data[sizeof(adv_ibeacon)];
+    uint32_t len;
+
+    // truncated to just before the last field
+    EXPECT_EQ(0, decode_beacon_adv(adv_ibeacon, sizeof(adv_ibeacon) - 1, &r));
+    for(len = 0; len < sizeof(adv_tag); len++)
+    {
+        EXPECT_EQ(0, decode_beacon_adv(adv_tag, len, &r));
+    }
+
+    // unknown iBeacon subtype
+    memcpy(data, adv_ibeacon, sizeof(data));
+    data[7] = 0x03;
+    EXPECT_EQ(0, decode_beacon_adv(data, sizeof(data), &r));
+
+    // wrong tag
+    memcpy(data, adv_tag, sizeof(adv_tag));
+    data[12] = 0xAD;
+    EXPECT_EQ(0, decode_beacon_adv(data, sizeof(adv_tag), &r));
+
+    // 0xAE is the authenticated tag, decoded here and verified later
+    data[12] = 0xAE;
+    ASSERT_EQ(1, decode_beacon_adv(data, sizeof(adv_tag), &r));
+    EXPECT_EQ(BEACON_FMT_BEACON_TAG_AUTH, r.format);
+}
+
+TEST_F(TestBleBeaconSchema, ble_beacon_schema_table)
+{
+    const BEACON_SCHEMA_T *s;
+    uint8_t f;
+
+    EXPECT_TRUE(get_beacon_schema(BEACON_FMT_COUNT) == NULL);
+    for(f = 0; f < BEACON_FMT_COUNT; f++)
+    {
+        s = get_beacon_schema(f);
+        ASSERT_TRUE(s != NULL);
+        EXPECT_GT(s->min_len, s->magic_off);
+        EXPECT_GT(s->min_len, s->value_off);
+        EXPECT_NE(0, s->object_id);
+    }
+    s = get_beacon_schema(BEACON_FMT_IBEACON);
+    EXPECT_EQ(25, s->min_len);
+    EXPECT_EQ(3300, s->object_id);
+}
+
+// a reading reused across formats keeps nothing from the previous one
+TEST_F(TestBleBeaconSchema, ble_beacon_schema_interleaved)
+{
+    const uint8_t *advs[] = { adv_tag, adv_ibeacon, adv_tlm, adv_ruuvi };
+    const uint32_t lens[] = { sizeof(adv_tag), sizeof(adv_ibeacon), sizeof(adv_tlm), sizeof(adv_ruuvi) };
+    const uint8_t formats[] = { BEACON_FMT_BEACON_TAG, BEACON_FMT_IBEACON, BEACON_FMT_EDDYSTONE_TLM, BEACON_FMT_RUUVI_RAWV2 };
+    const uint8_t seq_bits[] = { 0, 0, 32, 16 };
+    BEACON_READING_T r;
+    uint32_t i;
+
+    for(i = 0; i < 8; i++)
+    {
+        ASSERT_EQ(1, decode_beacon_adv(advs[i & 3u], lens[i & 3u], &r));
+        EXPECT_EQ(formats[i & 3u], r.format);
+        EXPECT_EQ(seq_bits[i & 3u], r.seq_bits);
+    }
+}
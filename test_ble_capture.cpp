@@ -0,0 +1,100 @@
+#include "gtest/gtest.h"
+extern "C"
+{
+#include "ble_capture.h"
+}
+#include <stdio.h>
+#include <string.h>
+
+class TestBleCapture : public testing::Test {
+    virtual void SetUp()
+    {
+    }
+
+    virtual void TearDown()
+    {
+    }
+};
+
+TEST_F(TestBleCapture, ble_capture_parse)
+{
+    BEACON_CAPTURE_REC_T rec;
+
+    ASSERT_EQ(1, parse_capture_line("1250 c0:00:00:00:01:02 1 -67 2 02010606ff5900AF0715\n", &rec));
+    EXPECT_EQ(1250u, rec.time_ms);
+    EXPECT_EQ(0x02, rec.report.addr[0]);
+    EXPECT_EQ(0x01, rec.report.addr[1]);
+    EXPECT_EQ(0xC0, rec.report.addr[5]);
+    EXPECT_EQ(1, rec.report.addr_type);
+    EXPECT_EQ(-67, rec.report.rssi);
+    EXPECT_EQ(BEACON_PHY_CODED, rec.report.phy);
+    EXPECT_EQ(10, rec.report.len);
+    EXPECT_EQ(0xAF, rec.report.data[7]);
+
+    // empty payload
+    ASSERT_EQ(1, parse_capture_line("  7\tc0:00:00:00:01:02 0 -40 0", &rec));
+    EXPECT_EQ(0, rec.report.len);
+
+    EXPECT_EQ(0, parse_capture_line("", &rec));
+    EXPECT_EQ(0, parse_capture_line("\n", &rec));
+    EXPECT_EQ(0, parse_capture_line("# time addr type rssi phy payload", &rec));
+}
+
+TEST_F(TestBleCapture, ble_capture_malformed)
+{
+    BEACON_CAPTURE_REC_T rec;
+    char line[BEACON_CAPTURE_LINE_MAX * 2];
+    uint32_t i;
+
+    EXPECT_EQ(0, parse_capture_line("x c0:00:00:00:01:02 1 -67 0 00", &rec));
+    EXPECT_EQ(0, parse_capture_line("1 c0:00:00:00:01 1 -67 0 00", &rec));
+    EXPECT_EQ(0, parse_capture_line("1 c0-00-00-00-01-02 1 -67 0 00", &rec));
+    EXPECT_EQ(0, parse_capture_line("1 c0:00:00:00:01:02 4 -67 0 00", &rec));
+    EXPECT_EQ(0, parse_capture_line("1 c0:00:00:00:01:02 1 -200 0 00", &rec));
+    EXPECT_EQ(0, parse_capture_line("1 c0:00:00:00:01:02 1 -67 3 00", &rec));
+    EXPECT_EQ(0, parse_capture_line("1 c0:00:00:00:01:02 1 -67 0 0a1", &rec));
+    EXPECT_EQ(0, parse_capture_line("1 c0:00:00:00:01:02 1 -67 0 0a zz", &rec));
+
+    // payload longer than a report holds
+    strcpy(line, "1 c0:00:00:00:01:02 1 -67 0 ");
+    for(i = 0; i <= BEACON_ADV_DATA_MAX; i++)
+    {
+        strcat(line, "aa");
+    }
+    EXPECT_EQ(0, parse_capture_line(line, &rec));
+}
+
+TEST_F(TestBleCapture, ble_capture_round_trip)
+{
+    BEACON_CAPTURE_REC_T rec;
+    BEACON_CAPTURE_REC_T out;
+    char line[BEACON_CAPTURE_LINE_MAX];
+    uint32_t i;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.time_ms = 123456;
+    for(i = 0; i < BEACON_ADDR_LEN; i++)
+    {
+        rec.report.addr[i] = (uint8_t)(0x10 + i);
+    }
+    rec.report.addr_type = 3;
+    rec.report.rssi = -128;
+    rec.report.phy = BEACON_PHY_2M;
+    rec.report.len = BEACON_ADV_DATA_MAX;
+    for(i = 0; i < BEACON_ADV_DATA_MAX; i++)
+    {
+        rec.report.data[i] = (uint8_t)(i * 9);
+    }
+
+    ASSERT_GT(format_capture_line(&rec, line, sizeof(line)), 0u);
+    EXPECT_EQ(0u, format_capture_line(&rec, line, 40));
+    ASSERT_GT(format_capture_line(&rec, line, sizeof(line)), 0u);
+    ASSERT_EQ(1, parse_capture_line(line, &out));
+    EXPECT_EQ(rec.time_ms, out.time_ms);
+    EXPECT_EQ(0, memcmp(rec.report.addr, out.report.addr, BEACON_ADDR_LEN));
+    EXPECT_EQ(rec.report.addr_type, out.report.addr_type);
+    EXPECT_EQ(rec.report.rssi, out.report.rssi);
+    EXPECT_EQ(rec.report.phy, out.report.phy);
+    ASSERT_EQ(rec.report.len, out.report.len);
+    EXPECT_EQ(0, memcmp(rec.report.data, out.report.data, rec.report.len));
+}
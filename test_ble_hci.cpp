@@ -0,0 +1,161 @@
+#include "gtest/gtest.h"
+extern "C"
+{
+#include "ble_adv_dedup.h"
+#include "ble_hci.h"
+#include "ble_sample_ring.h"
+#include "ble_scan_batch.h"
+}
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+class TestBleHci : public testing::Test {
+    virtual void SetUp()
+    {
+        init_adv_dedup(1000);
+        init_sample_ring();
+        init_scan_batch(NULL);
+    }
+
+    virtual void TearDown()
+    {
+    }
+};
+
+// LE Advertising Report event with tag frames from advertisers first..first+count-1
+static uint32_t build_adv_event(uint8_t *buf, uint8_t first, uint8_t count, uint8_t temp)
+{
+    static const uint8_t adv[] = { 0x02, 0x01, 0x06, 0x06, 0xFF, 0x59, 0x00, 0xAF, 0x00, 0x00 };
+    uint32_t len = 5;
+    uint8_t i;
+
+    buf[0] = BLE_HCI_EVENT_PKT;
+    buf[1] = BLE_HCI_EVT_LE_META;
+    buf[3] = BLE_HCI_LE_ADV_REPORT;
+    buf[4] = count;
+    for(i = 0; i < count; i++)
+    {
+        buf[len++] = 0x03;                // ADV_NONCONN_IND
+        buf[len++] = 0x01;                // random address
+        buf[len++] = (uint8_t)(first + i);
+        memset(&buf[len], 0xC0, BEACON_ADDR_LEN - 1);
+        len += BEACON_ADDR_LEN - 1;
+        buf[len++] = sizeof(adv);
+        memcpy(&buf[len], adv, sizeof(adv));
+        buf[len + 8] = (uint8_t)(first + i);
+        buf[len + 9] = temp;
+        len += sizeof(adv);
+        buf[len++] = (uint8_t)(-55 - i);
+    }
+    buf[2] = (uint8_t)(len - 3);
+    return len;
+}
+
+TEST_F(TestBleHci, ble_hci_commands)
+{
+    uint8_t buf[BLE_HCI_COMMAND_MAX];
+    static const uint8_t params[] = { 0x01, 0x0B, 0x20, 0x07, 0x00, 0xA0, 0x00, 0x50, 0x00, 0x00, 0x01 };
+    static const uint8_t enable[] = { 0x01, 0x0C, 0x20, 0x02, 0x01, 0x00 };
+
+    ASSERT_EQ(sizeof(params), ble_hci_build_set_scan_params(buf, 0, 0x00A0, 0x0050, 1));
+    EXPECT_EQ(0, memcmp(buf, params, sizeof(params)));
+    ASSERT_EQ(sizeof(enable), ble_hci_build_set_scan_enable(buf, 1, 0));
+    EXPECT_EQ(0, memcmp(buf, enable, sizeof(enable)));
+}
+
+TEST_F(TestBleHci, ble_hci_adv_report)
+{
+    BLE_HCI_RX_T rx;
+    BEACON_SAMPLE_T s;
+    uint8_t buf[BLE_HCI_EVENT_MAX];
+    uint32_t len;
+    uint32_t i;
+
+    ble_hci_rx_init(&rx);
+    len = build_adv_event(buf, 7, 3, 21);
+
+    // one byte at a time, the last byte completes the event
+    for(i = 0; i < len - 1; i++)
+    {
+        EXPECT_EQ(0u, ble_hci_rx_feed(&rx, &buf[i], 1));
+    }
+    EXPECT_EQ(3u, ble_hci_rx_feed(&rx, &buf[len - 1], 1));
+    EXPECT_EQ(1u, rx.events);
+    EXPECT_EQ(3u, get_scan_reports_pending());
+
+    EXPECT_EQ(3u, process_scan_batch(BEACON_BATCH_SIZE, 0));
+    for(i = 0; i < 3; i++)
+    {
+        ASSERT_EQ(1, pop_beacon_sample(&s));
+        EXPECT_EQ(7 + i, s.addr[0]);
+        EXPECT_EQ(0xC0, s.addr[5]);
+        EXPECT_EQ(1, s.addr_type);
+        EXPECT_EQ(7 + i, s.id);
+        EXPECT_EQ(21.0f, s.value);
+    }
+    EXPECT_EQ(0, pop_beacon_sample(&s));
+    EXPECT_EQ(0u, rx.errors);
+}
+
+TEST_F(TestBleHci, ble_hci_stream)
+{
+    BLE_HCI_RX_T rx;
+    uint8_t buf[3 * BLE_HCI_EVENT_MAX];
+    uint32_t len = 0;
+
+    ble_hci_rx_init(&rx);
+
+    // noise, command complete, adv report, unrelated event, truncated adv report
+    buf[len++] = 0x00;
+    buf[len++] = 0x02;
+    static const uint8_t cmd_complete[] = { 0x04, 0x0E, 0x04, 0x01, 0x0C, 0x20, 0x0C };
+    memcpy(&buf[len], cmd_complete, sizeof(cmd_complete));
+    len += sizeof(cmd_complete);
+    len += build_adv_event(&buf[len], 1, 1, 30);
+    static const uint8_t disconnect[] = { 0x04, 0x05, 0x04, 0x00, 0x40, 0x00, 0x13 };
+    memcpy(&buf[len], disconnect, sizeof(disconnect));
+    len += sizeof(disconnect);
+    uint32_t start = len;
+    len += build_adv_event(&buf[len], 2, 2, 30);
+    // second report cut short, the first one still counts
+    buf[start + 2] -= 3;
+    len -= 3;
+
+    EXPECT_EQ(2u, ble_hci_rx_feed(&rx, buf, len));
+    EXPECT_EQ(4u, rx.events);
+    EXPECT_EQ(2u, rx.adv_reports);
+    EXPECT_EQ(3u, rx.errors);
+    EXPECT_EQ(1u, rx.cmd_count);
+    EXPECT_EQ(BLE_HCI_OP_LE_SET_SCAN_ENABLE, rx.cmd_opcode);
+    EXPECT_EQ(0x0C, rx.cmd_status);
+    EXPECT_EQ(0u, rx.len);
+}
+
+// socketpair stand-in for the HCI socket
+TEST_F(TestBleHci, ble_hci_socketpair)
+{
+    BLE_HCI_RX_T rx;
+    uint8_t buf[2 * BLE_HCI_EVENT_MAX];
+    uint32_t len;
+    int sv[2];
+
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    ble_hci_rx_init(&rx);
+
+    EXPECT_EQ(0u, ble_hci_rx_poll(&rx, sv[1], 0));
+
+    len = build_adv_event(buf, 1, 2, 25);
+    len += build_adv_event(&buf[len], 3, 1, 26);
+    ASSERT_EQ(10, write(sv[0], buf, 10));
+    EXPECT_EQ(0u, ble_hci_rx_poll(&rx, sv[1], 100));
+    ASSERT_EQ((ssize_t)(len - 10), write(sv[0], &buf[10], len - 10));
+    EXPECT_EQ(3u, ble_hci_rx_poll(&rx, sv[1], 100));
+    EXPECT_EQ(2u, rx.events);
+    EXPECT_EQ(3u, process_scan_batch(BEACON_BATCH_SIZE, 0));
+
+    close(sv[0]);
+    EXPECT_EQ(INVALID_U32, ble_hci_rx_poll(&rx, sv[1], 100));
+    close(sv[1]);
+}
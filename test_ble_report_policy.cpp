@@ -0,0 +1,125 @@
+#include "gtest/gtest.h"
+extern "C"
+{
+#include "ble_report_policy.h"
+}
+#include <stdio.h>
+#include <string.h>
+
+class TestBleReportPolicy : public testing::Test {
+    virtual void SetUp()
+    {
+    }
+
+    virtual void TearDown()
+    {
+    }
+};
+
+TEST_F(TestBleReportPolicy, ble_report_policy_deadband)
+{
+    const BEACON_REPORT_POLICY_T policy = { 0.5f, 0.1f, 0, 0, 0 };
+    BEACON_REPORT_STATE_T state;
+    time_t now = 1000;
+
+    memset(&state, 0, sizeof(state));
+    EXPECT_EQ(0, report_policy_due(&policy, &state, 2.0f));
+    EXPECT_EQ(0, check_report_policy(&policy, &state, 2.0f, 0, now));
+
+    // first value goes out, repeats of it do not
+    EXPECT_EQ(1, check_report_policy(&policy, &state, 2.0f, 1, now));
+    EXPECT_EQ(0, check_report_policy(&policy, &state, 2.0f, 1, ++now));
+    EXPECT_EQ(0, report_policy_due(&policy, &state, 2.0f));
+
+    // absolute band at small values
+    EXPECT_EQ(0, check_report_policy(&policy, &state, 2.5f, 1, ++now));
+    EXPECT_EQ(1, check_report_policy(&policy, &state, 2.6f, 1, ++now));
+    EXPECT_FLOAT_EQ(2.6f, state.last_value);
+
+    // slow drift is measured from the last reported value
+    EXPECT_EQ(0, check_report_policy(&policy, &state, 2.3f, 1, ++now));
+    EXPECT_EQ(1, check_report_policy(&policy, &state, 2.0f, 1, ++now));
+
+    // relative band at large values
+    EXPECT_EQ(1, check_report_policy(&policy, &state, -100.0f, 1, ++now));
+    EXPECT_EQ(0, check_report_policy(&policy, &state, -109.0f, 1, ++now));
+    EXPECT_EQ(1, check_report_policy(&policy, &state, -111.0f, 1, ++now));
+}
+
+TEST_F(TestBleReportPolicy, ble_report_policy_periods)
+{
+    const BEACON_REPORT_POLICY_T policy = { 1.0f, 0.0f, 10, 60, 0 };
+    BEACON_REPORT_STATE_T state;
+    time_t now = 1000;
+
+    memset(&state, 0, sizeof(state));
+    EXPECT_EQ(1, check_report_policy(&policy, &state, 20.0f, 1, now));
+
+    // a real change inside the minimum period waits for it, without new samples
+    EXPECT_EQ(0, check_report_policy(&policy, &state, 25.0f, 1, now + 5));
+    EXPECT_EQ(now + 10, report_policy_due(&policy, &state, 25.0f));
+    EXPECT_EQ(0, check_report_policy(&policy, &state, 25.0f, 0, now + 9));
+    EXPECT_EQ(1, check_report_policy(&policy, &state, 25.0f, 0, now + 10));
+    EXPECT_EQ(0, report_policy_due(&policy, &state, 25.0f));
+    now += 10;
+
+    // a change inside the deadband goes out after the maximum period
+    EXPECT_EQ(0, check_report_policy(&policy, &state, 25.5f, 1, now + 20));
+    EXPECT_EQ(now + 60, report_policy_due(&policy, &state, 25.5f));
+    EXPECT_EQ(0, check_report_policy(&policy, &state, 25.5f, 0, now + 59));
+    EXPECT_EQ(1, check_report_policy(&policy, &state, 25.5f, 0, now + 60));
+
+    // nothing new, nothing sent
+    EXPECT_EQ(0, check_report_policy(&policy, &state, 25.5f, 0, now + 1000));
+    EXPECT_EQ(0, report_policy_due(&policy, &state, 25.5f));
+}
+
+TEST_F(TestBleReportPolicy, ble_report_policy_heartbeat)
+{
+    const BEACON_REPORT_POLICY_T policy = { 1.0f, 0.0f, 0, 0, 100 };
+    BEACON_REPORT_STATE_T state;
+    time_t now = 1000;
+    uint32_t reports = 0;
+    uint32_t t;
+
+    memset(&state, 0, sizeof(state));
+    EXPECT_EQ(1, check_report_policy(&policy, &state, 20.0f, 1, now));
+    EXPECT_EQ(now + 100, report_policy_due(&policy, &state, 20.0f));
+
+    // steady value, one report per heartbeat
+    for(t = 1; t <= 1000; t++)
+    {
+        reports += check_report_policy(&policy, &state, 20.0f, (t % 7) == 0, now + t);
+    }
+    EXPECT_EQ(10u, reports);
+    EXPECT_EQ(now + 1000, state.last_time);
+}
+
+TEST_F(TestBleReportPolicy, ble_report_policy_due)
+{
+    const BEACON_REPORT_POLICY_T policy = { 1.0f, 0.0f, 10, 300, 3600 };
+    BEACON_REPORT_STATE_T state;
+    time_t now = 1000;
+    time_t t;
+
+    // not reported yet, due once a sample arrives
+    memset(&state, 0, sizeof(state));
+    EXPECT_EQ(0, report_policy_due(&policy, &state, 20.0f));
+    EXPECT_EQ(1, check_report_policy(&policy, &state, 20.0f, 1, now));
+
+    // an idle reported value is only due at its heartbeat
+    EXPECT_EQ(now + 3600, report_policy_due(&policy, &state, 20.0f));
+    for(t = now + 1; t < now + 3600; t += 10)
+    {
+        EXPECT_EQ(0, check_report_policy(&policy, &state, 20.0f, 0, t));
+        EXPECT_EQ(now + 3600, report_policy_due(&policy, &state, 20.0f));
+    }
+    EXPECT_EQ(1, check_report_policy(&policy, &state, 20.0f, 0, now + 3600));
+    now += 3600;
+    EXPECT_EQ(now + 3600, report_policy_due(&policy, &state, 20.0f));
+
+    // a change is due after the minimum period, a small one after the maximum
+    EXPECT_EQ(0, check_report_policy(&policy, &state, 30.0f, 1, now + 1));
+    EXPECT_EQ(now + 10, report_policy_due(&policy, &state, 30.0f));
+    EXPECT_EQ(now + 300, report_policy_due(&policy, &state, 20.5f));
+}
@@ -0,0 +1,97 @@
+#include "gtest/gtest.h"
+extern "C"
+{
+#include "ble_sample_ring.h"
+}
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+class TestBleSampleRing : public testing::Test {
+    virtual void SetUp()
+    {
+        init_sample_ring();
+    }
+
+    virtual void TearDown()
+    {
+    }
+};
+
+static BEACON_SAMPLE_T make_sample(uint32_t n)
+{
+    BEACON_SAMPLE_T s;
+
+    memset(&s, 0, sizeof(s));
+    s.addr[0] = (uint8_t)n;
+    s.addr[1] = (uint8_t)(n >> 8);
+    s.addr[2] = (uint8_t)(n >> 16);
+    s.id      = (uint8_t)(n >> 24);
+    s.value   = (float)(uint8_t)(n * 7);
+    return s;
+}
+
+TEST_F(TestBleSampleRing, ble_sample_ring_test)
+{
+    BEACON_SAMPLE_T s;
+    uint32_t i;
+
+    EXPECT_EQ(0, pop_beacon_sample(&s));
+
+    // fill, overflow is dropped and counted
+    for(i = 0; i < BEACON_SAMPLE_RING_SIZE; i++)
+    {
+        s = make_sample(i);
+        EXPECT_EQ(1, push_beacon_sample(&s));
+    }
+    s = make_sample(i);
+    EXPECT_EQ(0, push_beacon_sample(&s));
+    EXPECT_EQ(1u, get_sample_ring_drops());
+
+    // drained in FIFO order
+    for(i = 0; i < BEACON_SAMPLE_RING_SIZE; i++)
+    {
+        EXPECT_EQ(1, pop_beacon_sample(&s));
+        EXPECT_EQ((uint8_t)i, s.addr[0]);
+        EXPECT_EQ((float)(uint8_t)(i * 7), s.value);
+    }
+    EXPECT_EQ(0, pop_beacon_sample(&s));
+}
+
+TEST_F(TestBleSampleRing, ble_sample_ring_threads_test)
+{
+    const uint32_t count = 200000;
+    uint32_t pushed = 0;
+    uint32_t expected = 0;
+    uint32_t popped = 0;
+    BEACON_SAMPLE_T s;
+
+    std::thread producer([&]() {
+        uint32_t n;
+        for(n = 0; n < count; n++)
+        {
+            BEACON_SAMPLE_T p = make_sample(n);
+            if(push_beacon_sample(&p))
+            {
+                pushed++;
+            }
+        }
+    });
+
+    // every sample that got in arrives intact and in order
+    while(popped + get_sample_ring_drops() < count)
+    {
+        if(pop_beacon_sample(&s))
+        {
+            uint32_t n = s.addr[0] | (s.addr[1] << 8) | (s.addr[2] << 16) | ((uint32_t)s.id << 24);
+            EXPECT_GE(n, expected);
+            EXPECT_EQ((float)(uint8_t)(n * 7), s.value);
+            expected = n + 1;
+            popped++;
+        }
+    }
+    producer.join();
+
+    EXPECT_EQ(pushed, popped);
+    EXPECT_EQ(count, popped + get_sample_ring_drops());
+}
@@ -0,0 +1,207 @@
+#include "gtest/gtest.h"
+extern "C"
+{
+#include "ble_adv_dedup.h"
+#include "ble_sample_ring.h"
+#include "ble_scan_batch.h"
+}
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+static uint32_t test_clock_us()
+{
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class TestBleScanBatch : public testing::Test {
+    virtual void SetUp()
+    {
+        init_adv_dedup(1000);
+        init_sample_ring();
+        init_scan_batch(test_clock_us);
+    }
+
+    virtual void TearDown()
+    {
+    }
+};
+
+// tag frame from advertiser n with temperature t
+static uint8_t queue_report(uint32_t n, uint8_t t, uint8_t phy = BEACON_PHY_1M, int8_t rssi = -60)
+{
+    static const uint8_t adv[] = { 0x02, 0x01, 0x06, 0x06, 0xFF, 0x59, 0x00, 0xAF, 0x00, 0x00 };
+    BEACON_RAW_REPORT_T *r = reserve_scan_report();
+
+    if(r == NULL)
+    {
+        return 0;
+    }
+    memset(r->addr, 0, BEACON_ADDR_LEN);
+    r->addr[0]   = (uint8_t)n;
+    r->addr[1]   = (uint8_t)(n >> 8);
+    r->addr_type = 1;
+    r->rssi      = rssi;
+    r->phy       = phy;
+    r->len       = sizeof(adv);
+    memcpy(r->data, adv, sizeof(adv));
+    r->data[8]   = (uint8_t)n;
+    r->data[9]   = t;
+    commit_scan_report();
+    return 1;
+}
+
+TEST_F(TestBleScanBatch, ble_scan_batch_test)
+{
+    BEACON_SAMPLE_T s;
+    BEACON_BATCH_STATS_T stats;
+    uint32_t i;
+
+    EXPECT_EQ(0u, process_scan_batch(BEACON_BATCH_SIZE, 0));
+
+    for(i = 0; i < 20; i++)
+    {
+        EXPECT_EQ(1, queue_report(i, (uint8_t)(20 + i)));
+    }
+    EXPECT_EQ(20u, get_scan_reports_pending());
+
+    // at most one batch per call
+    EXPECT_EQ(16u, process_scan_batch(16, 0));
+    EXPECT_EQ(4u, get_scan_reports_pending());
+    EXPECT_EQ(4u, process_scan_batch(16, 0));
+    EXPECT_EQ(0u, get_scan_reports_pending());
+
+    for(i = 0; i < 20; i++)
+    {
+        ASSERT_EQ(1, pop_beacon_sample(&s));
+        EXPECT_EQ((uint8_t)i, s.addr[0]);
+        EXPECT_EQ(1, s.addr_type);
+        EXPECT_EQ((uint8_t)i, s.id);
+        EXPECT_EQ(-60, s.rssi);
+        EXPECT_EQ(0, s.seq_bits);
+        EXPECT_EQ((float)(20 + i), s.value);
+    }
+    EXPECT_EQ(0, pop_beacon_sample(&s));
+
+    // repeats are dropped before decoding
+    queue_report(3, 23);
+    queue_report(3, 24);
+    EXPECT_EQ(2u, process_scan_batch(16, 10));
+    ASSERT_EQ(1, pop_beacon_sample(&s));
+    EXPECT_EQ(24.0f, s.value);
+
+    get_scan_batch_stats(&stats);
+    EXPECT_EQ(3u, stats.batches);
+    EXPECT_EQ(22u, stats.reports);
+    EXPECT_EQ(21u, stats.decoded);
+    EXPECT_EQ(0u, stats.drops);
+    EXPECT_GE(stats.max_us, stats.last_us);
+}
+
+TEST_F(TestBleScanBatch, ble_scan_batch_full_test)
+{
+    BEACON_BATCH_STATS_T stats;
+    uint32_t i;
+
+    for(i = 0; i < BEACON_REPORT_RING_SIZE; i++)
+    {
+        EXPECT_EQ(1, queue_report(i, 0));
+    }
+    EXPECT_EQ(0, queue_report(i, 0));
+    EXPECT_EQ((uint32_t)BEACON_REPORT_RING_SIZE, get_scan_reports_pending());
+
+    get_scan_batch_stats(&stats);
+    EXPECT_EQ(1u, stats.drops);
+
+    // a processed batch frees its slots
+    process_scan_batch(BEACON_BATCH_SIZE, 0);
+    EXPECT_EQ(1, queue_report(i, 0));
+}
+
+TEST_F(TestBleScanBatch, ble_scan_batch_phy_test)
+{
+    BEACON_BATCH_STATS_T stats;
+
+    queue_report(1, 20, BEACON_PHY_1M, -50);
+    queue_report(2, 20, BEACON_PHY_1M, -70);
+    queue_report(3, 20, BEACON_PHY_CODED, -95);
+    queue_report(3, 20, BEACON_PHY_CODED, -96);
+    process_scan_batch(BEACON_BATCH_SIZE, 0);
+
+    get_scan_batch_stats(&stats);
+    EXPECT_EQ(2u, stats.phy[BEACON_PHY_1M].decoded);
+    EXPECT_EQ(-120, stats.phy[BEACON_PHY_1M].rssi_sum);
+    EXPECT_EQ(-70, stats.phy[BEACON_PHY_1M].rssi_min);
+    EXPECT_EQ(0u, stats.phy[BEACON_PHY_2M].reports);
+    EXPECT_EQ(127, stats.phy[BEACON_PHY_2M].rssi_min);
+    // the repeat is processed but not decoded
+    EXPECT_EQ(2u, stats.phy[BEACON_PHY_CODED].reports);
+    EXPECT_EQ(1u, stats.phy[BEACON_PHY_CODED].decoded);
+    EXPECT_EQ(-95, stats.phy[BEACON_PHY_CODED].rssi_min);
+    EXPECT_EQ(20u, stats.phy[BEACON_PHY_CODED].bytes);
+}
+
+#if BEACON_EXTENDED_SCAN
+// extended advertising payloads beyond 31 bytes fit in one report
+TEST_F(TestBleScanBatch, ble_scan_batch_extended_test)
+{
+    BEACON_RAW_REPORT_T *r = reserve_scan_report();
+    BEACON_SAMPLE_T s;
+    uint32_t i;
+
+    ASSERT_TRUE(r != NULL);
+    memset(r, 0, sizeof(*r));
+    r->phy = BEACON_PHY_CODED;
+    // long name first, beacon frame past the legacy payload limit
+    r->data[0] = 41;
+    r->data[1] = 0x09;
+    for(i = 0; i < 40; i++)
+    {
+        r->data[2 + i] = 'a' + (i % 26);
+    }
+    const uint8_t frame[] = { 0x06, 0xFF, 0x59, 0x00, 0xAF, 0x09, 0x19 };
+    memcpy(&r->data[42], frame, sizeof(frame));
+    r->len = 42 + sizeof(frame);
+    commit_scan_report();
+
+    EXPECT_EQ(1u, process_scan_batch(BEACON_BATCH_SIZE, 0));
+    ASSERT_EQ(1, pop_beacon_sample(&s));
+    EXPECT_EQ(0x09, s.id);
+    EXPECT_EQ(25.0f, s.value);
+}
+#endif
+
+// the batch size only splits the work, every report is decoded once
+TEST_F(TestBleScanBatch, ble_scan_batch_sizes_test)
+{
+    const uint32_t sizes[] = { 1, 4, 16, 32 };
+    const uint32_t reports = 100;
+    BEACON_BATCH_STATS_T stats;
+    uint32_t k;
+    uint32_t n;
+    uint32_t done;
+    uint32_t batch;
+
+    for(k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++)
+    {
+        init_adv_dedup(0);
+        init_scan_batch(test_clock_us);
+        for(n = 0, done = 0; done < reports; )
+        {
+            while(n < reports && n - done < sizes[k] && queue_report(n, (uint8_t)n))
+            {
+                n++;
+            }
+            batch = (n - done < sizes[k]) ? n - done : sizes[k];
+            EXPECT_EQ(batch, process_scan_batch(sizes[k], n));
+            done += batch;
+            init_sample_ring();
+        }
+        get_scan_batch_stats(&stats);
+        EXPECT_EQ((reports + sizes[k] - 1) / sizes[k], stats.batches);
+        EXPECT_EQ(reports, stats.reports);
+        EXPECT_EQ(reports, stats.decoded);
+        EXPECT_EQ(0u, get_scan_reports_pending());
+    }
+}
@@ -0,0 +1,104 @@
+#include "gtest/gtest.h"
+extern "C"
+{
+#include "ble_scan_sched.h"
+}
+#include <stdio.h>
+
+class TestBleScanSched : public testing::Test {
+    virtual void SetUp()
+    {
+    }
+
+    virtual void TearDown()
+    {
+    }
+};
+
+// beacons advertising at adv_hz, a report is heard with probability duty;
+// a beacon counts as fresh if it is expected to be heard within the deadline
+static void run_cycle(BEACON_SCAN_SCHED_T *sched, uint32_t beacons, float adv_hz, uint32_t cycle_ms,
+                      uint32_t *arrivals, uint32_t *fresh)
+{
+    float heard = adv_hz * sched->duty;
+    float per_deadline = heard * BEACON_FRESHNESS_DEADLINE;
+
+    *arrivals = (uint32_t)(heard * (cycle_ms / 1000.0f) * beacons);
+    *fresh = (per_deadline >= 1.0f) ? beacons : (uint32_t)(per_deadline * beacons);
+}
+
+TEST_F(TestBleScanSched, ble_scan_sched_backoff)
+{
+    BEACON_SCAN_SCHED_T sched;
+    uint32_t arrivals;
+    uint32_t fresh;
+    uint32_t i;
+
+    init_scan_sched(&sched, 500, 100);
+    EXPECT_FLOAT_EQ(0.2f, sched.duty);
+
+    // no beacons known: schedule stays
+    EXPECT_EQ(0, update_scan_sched(&sched, 0, 0, 0, 6000));
+    EXPECT_EQ(100, sched.window_ms);
+
+    // 50 chatty beacons (10 Hz), all fresh: duty cycle goes down
+    for(i = 0; i < 40; i++)
+    {
+        run_cycle(&sched, 50, 10.0f, 6000, &arrivals, &fresh);
+        update_scan_sched(&sched, arrivals, 50, 50, 6000);
+    }
+    printf("fresh room: interval %u ms window %u ms duty %.3f coverage %.2f\n",
+           sched.interval_ms, sched.window_ms, sched.duty, sched.coverage_avg);
+    EXPECT_LT(sched.duty, 0.05f);
+    EXPECT_GE(sched.duty, sched.min_duty);
+    EXPECT_GE(sched.window_ms, BEACON_SCAN_WINDOW_MIN_MS);
+    EXPECT_LE(sched.interval_ms, BEACON_SCAN_INTERVAL_MAX_MS);
+    EXPECT_EQ(sched.cycles, sched.cycles_on_target);
+}
+
+TEST_F(TestBleScanSched, ble_scan_sched_widen)
+{
+    BEACON_SCAN_SCHED_T sched;
+    uint32_t i;
+    float duty;
+
+    init_scan_sched(&sched, 500, 100);
+
+    // half the beacons stale: duty cycle at least doubles each cycle
+    duty = sched.duty;
+    EXPECT_EQ(1, update_scan_sched(&sched, 10, 50, 100, 6000));
+    EXPECT_GE(sched.duty, 2 * duty - 0.01f);
+    EXPECT_FLOAT_EQ(0.5f, sched.coverage);
+
+    for(i = 0; i < 5; i++)
+    {
+        update_scan_sched(&sched, 10, 50, 100, 6000);
+    }
+    EXPECT_EQ(sched.interval_ms, sched.window_ms);
+    EXPECT_FLOAT_EQ(1.0f, sched.duty);
+    EXPECT_EQ(0u, sched.cycles_on_target);
+    EXPECT_LT(sched.coverage_avg, 1.0f);
+}
+
+TEST_F(TestBleScanSched, ble_scan_sched_converge)
+{
+    BEACON_SCAN_SCHED_T sched;
+    uint32_t arrivals;
+    uint32_t fresh;
+    uint32_t i;
+
+    // slow beacons (0.5 Hz) start out partly missed, then the duty cycle
+    // settles where every beacon is heard
+    init_scan_sched(&sched, 500, 20);
+    for(i = 0; i < 30; i++)
+    {
+        run_cycle(&sched, 20, 0.5f, 6000, &arrivals, &fresh);
+        update_scan_sched(&sched, arrivals, fresh, 20, 6000);
+    }
+    printf("slow beacons: interval %u ms window %u ms duty %.3f, %lu/%lu cycles on target\n",
+           sched.interval_ms, sched.window_ms, sched.duty,
+           (unsigned long)sched.cycles_on_target, (unsigned long)sched.cycles);
+    EXPECT_EQ(1.0f, sched.coverage);
+    EXPECT_GT(sched.cycles_on_target, sched.cycles / 2);
+    EXPECT_LT(sched.duty, 0.5f);
+}
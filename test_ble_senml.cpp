@@ -0,0 +1,86 @@
+#include "gtest/gtest.h"
+extern "C"
+{
+#include "ble_senml.h"
+}
+#include <stdio.h>
+#include <string.h>
+
+class TestBleSenml : public testing::Test {
+    virtual void SetUp()
+    {
+    }
+
+    virtual void TearDown()
+    {
+    }
+};
+
+TEST_F(TestBleSenml, ble_senml_encode)
+{
+    static const uint8_t expected[] = {
+        0x82,
+        // {bt: 1000, n: "b0", v: 21.5}
+        0xA3, 0x22, 0x19, 0x03, 0xE8, 0x00, 0x62, 'b', '0', 0x02, 0xFA, 0x41, 0xAC, 0x00, 0x00,
+        // {n: "b1", t: -30, v: -2.5}
+        0xA3, 0x00, 0x62, 'b', '1', 0x06, 0x38, 0x1D, 0x02, 0xFA, 0xC0, 0x20, 0x00, 0x00
+    };
+    uint8_t buf[64];
+    BEACON_SENML_T pack;
+
+    senml_begin(&pack, buf, sizeof(buf), 1000);
+    EXPECT_EQ(0u, senml_finish(&pack));
+
+    senml_begin(&pack, buf, sizeof(buf), 1000);
+    ASSERT_EQ(1, senml_add_record(&pack, "b0", 1000, 21.5f));
+    ASSERT_EQ(1, senml_add_record(&pack, "b1", 970, -2.5f));
+    ASSERT_EQ(sizeof(expected), senml_finish(&pack));
+    EXPECT_EQ(0, memcmp(expected, buf, sizeof(expected)));
+}
+
+TEST_F(TestBleSenml, ble_senml_limits)
+{
+    uint8_t buf[BEACON_SENML_HEADER_MAX + 30 * BEACON_SENML_RECORD_MAX];
+    char name[BEACON_SENML_NAME_MAX + 2];
+    BEACON_SENML_T pack;
+    uint32_t len;
+    uint32_t i;
+
+    // worst case records always fit the documented bound
+    memset(name, 'x', sizeof(name));
+    name[BEACON_SENML_NAME_MAX] = '\0';
+    senml_begin(&pack, buf, sizeof(buf), 0x7FFFFFFF);
+    for(i = 0; i < 30; i++)
+    {
+        ASSERT_EQ(1, senml_add_record(&pack, name, -0x7FFFFFFF, -1.0f));
+    }
+    len = senml_finish(&pack);
+    EXPECT_LE(len, sizeof(buf));
+    EXPECT_EQ(0x98, buf[0]);
+    EXPECT_EQ(30, buf[1]);
+    EXPECT_EQ(0xA4, buf[2]);
+
+    // longest name with 64 bit base time and offset fills the bound exactly
+    senml_begin(&pack, buf, BEACON_SENML_HEADER_MAX + BEACON_SENML_RECORD_MAX, (time_t)0x200000000LL);
+    ASSERT_EQ(1, senml_add_record(&pack, name, 0, -1.0f));
+    len = senml_finish(&pack);
+    EXPECT_EQ((uint32_t)(1 + (1 + 9) + BEACON_SENML_RECORD_MAX), len);
+    EXPECT_EQ(0x78, buf[13]);
+    EXPECT_EQ(BEACON_SENML_NAME_MAX, buf[14]);
+
+    // too long a name is refused
+    name[BEACON_SENML_NAME_MAX] = 'x';
+    name[BEACON_SENML_NAME_MAX + 1] = '\0';
+    senml_begin(&pack, buf, sizeof(buf), 0);
+    EXPECT_EQ(0, senml_add_record(&pack, name, 0, 0.0f));
+
+    // a full buffer leaves the pack as it was
+    senml_begin(&pack, buf, 20, 0);
+    EXPECT_EQ(1, senml_add_record(&pack, "b0", 0, 1.0f));
+    EXPECT_EQ(0, senml_add_record(&pack, "b1", 0, 1.0f));
+    EXPECT_EQ(1u, pack.count);
+    len = senml_finish(&pack);
+    EXPECT_EQ(0x81, buf[0]);
+    EXPECT_EQ(0xA3, buf[1]);
+    EXPECT_EQ(1u + 13u, len);
+}
@@ -0,0 +1,180 @@
+#include "gtest/gtest.h"
+#if defined(__linux__)
+#include "hci_scanner.h"
+extern "C"
+{
+#include "ble_adv_dedup.h"
+#include "ble_hci.h"
+#include "ble_sample_ring.h"
+#include "ble_scan_batch.h"
+}
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+class TestHciScanner : public testing::Test {
+    virtual void SetUp()
+    {
+        init_adv_dedup(1000);
+        init_sample_ring();
+        init_scan_batch(NULL);
+        ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    }
+
+    virtual void TearDown()
+    {
+        close(sv[1]);
+    }
+
+protected:
+    // sv[0] is the scanner's HCI socket, the test plays the controller on sv[1]
+    int sv[2];
+};
+
+// read exactly len bytes from the scanner within timeout_ms, return 1 if ok
+static uint8_t read_all(int fd, uint8_t *buf, uint32_t len, int timeout_ms)
+{
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    uint32_t got = 0;
+    ssize_t n;
+
+    while(got < len)
+    {
+        if(poll(&pfd, 1, timeout_ms) != 1 || (n = read(fd, &buf[got], len - got)) <= 0)
+        {
+            return 0;
+        }
+        got += (uint32_t)n;
+    }
+    return 1;
+}
+
+// read one command packet, return its opcode or 0 if none arrived
+static uint16_t read_command(int fd, uint8_t *params, int timeout_ms = 2000)
+{
+    uint8_t head[4];
+
+    if(!read_all(fd, head, sizeof(head), timeout_ms) || head[0] != BLE_HCI_COMMAND_PKT ||
+       !read_all(fd, params, head[3], timeout_ms))
+    {
+        return 0;
+    }
+    return (uint16_t)(head[1] | (head[2] << 8));
+}
+
+static void send_complete(int fd, uint16_t opcode, uint8_t status)
+{
+    const uint8_t evt[] = { BLE_HCI_EVENT_PKT, BLE_HCI_EVT_CMD_COMPLETE, 4, 1,
+                            (uint8_t)opcode, (uint8_t)(opcode >> 8), status };
+
+    ASSERT_EQ((ssize_t)sizeof(evt), write(fd, evt, sizeof(evt)));
+}
+
+// LE Advertising Report event with one tag frame
+static void send_adv_report(int fd, uint8_t id, uint8_t temp)
+{
+    static const uint8_t adv[] = { 0x02, 0x01, 0x06, 0x06, 0xFF, 0x59, 0x00, 0xAF, 0x00, 0x00 };
+    uint8_t buf[BLE_HCI_EVENT_MAX];
+    uint32_t len = 5;
+
+    buf[0] = BLE_HCI_EVENT_PKT;
+    buf[1] = BLE_HCI_EVT_LE_META;
+    buf[3] = BLE_HCI_LE_ADV_REPORT;
+    buf[4] = 1;
+    buf[len++] = 0x03;                    // ADV_NONCONN_IND
+    buf[len++] = 0x01;                    // random address
+    buf[len++] = id;
+    memset(&buf[len], 0xC0, BEACON_ADDR_LEN - 1);
+    len += BEACON_ADDR_LEN - 1;
+    buf[len++] = sizeof(adv);
+    memcpy(&buf[len], adv, sizeof(adv));
+    buf[len + 8] = id;
+    buf[len + 9] = temp;
+    len += sizeof(adv);
+    buf[len++] = (uint8_t)-60;
+    buf[2] = (uint8_t)(len - 3);
+    ASSERT_EQ((ssize_t)len, write(fd, buf, len));
+}
+
+// wait for the scanner thread to deliver a sample
+static uint8_t wait_sample(BEACON_SAMPLE_T *sample, int timeout_ms)
+{
+    while(!pop_beacon_sample(sample))
+    {
+        if(timeout_ms-- <= 0)
+        {
+            return 0;
+        }
+        usleep(1000);
+    }
+    return 1;
+}
+
+static void *stop_scanner(void *arg)
+{
+    static_cast<HciScanner *>(arg)->stop();
+    return NULL;
+}
+
+TEST_F(TestHciScanner, hci_scanner_scan)
+{
+    HciScanner scanner(0, sv[0]);
+    uint8_t params[255];
+    BEACON_SAMPLE_T sample;
+    pthread_t stopper;
+
+    scanner.run();
+
+    // disable left over scanning, set parameters, enable
+    ASSERT_EQ(BLE_HCI_OP_LE_SET_SCAN_ENABLE, read_command(sv[1], params));
+    EXPECT_EQ(0, params[0]);
+    send_complete(sv[1], BLE_HCI_OP_LE_SET_SCAN_ENABLE, 0);
+    ASSERT_EQ(BLE_HCI_OP_LE_SET_SCAN_PARAMS, read_command(sv[1], params));
+    EXPECT_EQ(0, params[0]);              // passive
+    EXPECT_EQ(BEACON_HCI_SCAN_INTERVAL, params[1] | (params[2] << 8));
+    EXPECT_EQ(BEACON_HCI_SCAN_WINDOW, params[3] | (params[4] << 8));
+    send_complete(sv[1], BLE_HCI_OP_LE_SET_SCAN_PARAMS, 0);
+    ASSERT_EQ(BLE_HCI_OP_LE_SET_SCAN_ENABLE, read_command(sv[1], params));
+    EXPECT_EQ(1, params[0]);
+    send_complete(sv[1], BLE_HCI_OP_LE_SET_SCAN_ENABLE, 0);
+
+    // a report reaches the sample ring within the batch latency limit
+    send_adv_report(sv[1], 7, 22);
+    ASSERT_EQ(1, wait_sample(&sample, 2000));
+    EXPECT_EQ(7, sample.addr[0]);
+    EXPECT_EQ(1, sample.addr_type);
+    EXPECT_EQ(7, sample.id);
+    EXPECT_EQ(-60, sample.rssi);
+    EXPECT_EQ(22.0f, sample.value);
+
+    // stop() disables scanning before the thread exits
+    ASSERT_EQ(0, pthread_create(&stopper, NULL, stop_scanner, &scanner));
+    ASSERT_EQ(BLE_HCI_OP_LE_SET_SCAN_ENABLE, read_command(sv[1], params));
+    EXPECT_EQ(0, params[0]);
+    send_complete(sv[1], BLE_HCI_OP_LE_SET_SCAN_ENABLE, 0);
+    pthread_join(stopper, NULL);
+    EXPECT_EQ(0u, get_sample_ring_drops());
+}
+
+TEST_F(TestHciScanner, hci_scanner_command_failure)
+{
+    HciScanner scanner(0, sv[0]);
+    uint8_t params[255];
+
+    scanner.run();
+
+    // a failed disable is ignored, a failed parameter set ends the session
+    ASSERT_EQ(BLE_HCI_OP_LE_SET_SCAN_ENABLE, read_command(sv[1], params));
+    send_complete(sv[1], BLE_HCI_OP_LE_SET_SCAN_ENABLE, 0x0C);
+    ASSERT_EQ(BLE_HCI_OP_LE_SET_SCAN_PARAMS, read_command(sv[1], params));
+    send_complete(sv[1], BLE_HCI_OP_LE_SET_SCAN_PARAMS, 0x0C);
+
+    // scanning is never enabled
+    EXPECT_EQ(0, read_command(sv[1], params, 200));
+    scanner.stop();
+    EXPECT_EQ(0, read_command(sv[1], params, 0));
+}
+
+#endif // __linux__
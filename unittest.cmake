@@ -5,12 +5,38 @@
 
 set(unittest-includes ${unittest-includes}
   ../ble_beacon
+  ../ble_beacon/source
 )
 
 set(unittest-sources
+  ../ble_beacon/ble_adv_dedup.c
+  ../ble_beacon/ble_adv_parser.c
   ../ble_beacon/ble_beacon.c
+  ../ble_beacon/ble_beacon_auth.c
+  ../ble_beacon/ble_beacon_schema.c
+  ../ble_beacon/ble_capture.c
+  ../ble_beacon/ble_hci.c
+  ../ble_beacon/ble_report_policy.c
+  ../ble_beacon/ble_sample_ring.c
+  ../ble_beacon/ble_scan_batch.c
+  ../ble_beacon/ble_scan_sched.c
+  ../ble_beacon/ble_senml.c
+  ../ble_beacon/source/hci_scanner.cpp
 )
 
 set(unittest-test-sources
+  ble_beacon/test_ble_adv_dedup.cpp
+  ble_beacon/test_ble_adv_parser.cpp
   ble_beacon/test_ble_beacon.cpp
+  ble_beacon/test_ble_beacon_auth.cpp
+  ble_beacon/test_ble_beacon_bench.cpp
+  ble_beacon/test_ble_beacon_schema.cpp
+  ble_beacon/test_ble_capture.cpp
+  ble_beacon/test_ble_hci.cpp
+  ble_beacon/test_ble_report_policy.cpp
+  ble_beacon/test_ble_sample_ring.cpp
+  ble_beacon/test_ble_scan_batch.cpp
+  ble_beacon/test_ble_scan_sched.cpp
+  ble_beacon/test_ble_senml.cpp
+  ble_beacon/test_hci_scanner.cpp
 )
\ No newline at end of file